@@ -0,0 +1,78 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <iostream>
+#include <cstdlib>
+
+#include <bhxx/bhxx.hpp>
+
+using namespace bhxx;
+
+// Checks that the error of a failed asynchronous flush is reported by the next flush
+// and that the instructions enqueued in the meantime are still executed
+int compute() {
+    BhArray<uint64_t> a({100});
+    identity(a, 1);
+    Runtime::instance().flush();
+
+    {
+        // The allocation of more memory than the address space fails in the executor thread
+        BhArray<uint8_t> huge({1ul << 50});
+        identity(huge, 0);
+        Runtime::instance().flush();
+    }
+
+    BhArray<uint64_t> c({100});
+    {
+        BhArray<uint64_t> tmp({100});
+        identity(tmp, 2);
+        add(c, a, tmp);
+    }
+    Runtime::instance().sync(c.base);
+
+    bool reported = false;
+    try {
+        Runtime::instance().flush();
+    } catch (const std::exception &e) {
+        std::cout << "Reported error: " << e.what() << std::endl;
+        reported = true;
+    }
+    if (not reported) {
+        std::cerr << "The error of the failed flush wasn't reported" << std::endl;
+        return 1;
+    }
+
+    // The batch that was enqueued when the error was reported must still be executed
+    Runtime::instance().sync(c.base);
+    Runtime::instance().flush();
+    for (uint64_t i = 0; i < 100; ++i) {
+        if (c.data() == nullptr or c.data()[i] != 3) {
+            std::cerr << "The enqueued batch was lost" << std::endl;
+            return 1;
+        }
+    }
+    std::cout << "The enqueued batch was executed" << std::endl;
+    return 0;
+}
+
+int main() {
+    // NB: the runtime is created at the first use, thus we can enable asynchronous flushes here
+    setenv("BH_BRIDGE_ASYNC_FLUSH", "true", 1);
+    return compute();
+}
@@ -21,6 +21,11 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
 #include <sstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
 
 #include "BhInstruction.hpp"
 #include <bh_component.hpp>
@@ -32,14 +37,17 @@ namespace bhxx {
  *  Implemented as a Singleton.
  *
  *  \note  Not thread-safe.
+ *
+ *  When the bridge option `async_flush` is enabled, flushes are executed by a dedicated executor thread
+ *  while the calling thread keeps recording instructions. A flush blocks only when it syncs arrays and
+ *  the runtime calls that access array data (e.g. `getMemoryPointer()`) block only on arrays that are
+ *  still in flight.
  */
 class Runtime {
 public:
     Runtime();
 
-    ~Runtime() {
-        flush();
-    }
+    ~Runtime();
 
     /// Get the singleton instance of the Runtime class
     static Runtime &instance() {
@@ -82,6 +90,21 @@ public:
     /// Flag array to be sync'ed after the next flush
     void sync(std::shared_ptr<BhBase> &base_ptr);
 
+    /** Block until no flush in flight accesses `base`.
+     * NB: this is a no-op when flushes are synchronous
+     *
+     * @base  The base array to wait for
+     * Throws the exception of a failed asynchronous flush
+     */
+    void wait(const bh_base *base);
+
+    /** Block until all flushes in flight have been executed.
+     * NB: this is a no-op when flushes are synchronous
+     *
+     * Throws the exception of a failed asynchronous flush
+     */
+    void waitAll();
+
     /** Changes the offset and shape of a view between the iterations of a `do_while` loop.
      * This is the underlying functionality behind using iterators.
      *
@@ -149,6 +172,9 @@ public:
     void memCopy(BhArray<T> &src, BhArray<T> &dst, const std::string &param) {
         bh_view _src = src.getBhView();
         bh_view _dst = dst.getBhView();
+        wait(_src.base);
+        wait(_dst.base);
+        std::lock_guard<std::mutex> guard(runtime_mutex);
         runtime.memCopy(_src, _dst, param);
     }
 
@@ -196,6 +222,27 @@ private:
     void freeMemory(BhArray<T> &ary);
     //@}
 
+    // A flushed BhIR that awaits execution by the executor thread
+    struct FlushJob {
+        std::vector<bh_instruction> instr_list;
+        std::set<bh_base *> syncs;
+        uint64_t nrepeats;
+        std::shared_ptr<BhBase> repeat_condition;
+        // Bases to purge after execution
+        std::vector<std::unique_ptr<BhBase> > bases_for_deletion;
+        // The bases accessed by the job, which are in flight until the job finishes
+        std::vector<const bh_base *> bases;
+    };
+
+    /// Send enqueued instructions to Bohrium for execution, which is asynchronous when `async_flush` is set
+    void _flush(uint64_t nrepeats, const std::shared_ptr<BhBase> &base_ptr);
+
+    /// The main loop of the executor thread
+    void executorLoop();
+
+    /// Rethrow the exception of a failed asynchronous flush (if any). NB: `queue_mutex` must be locked.
+    void rethrowExecutorError();
+
     // The lazy evaluated instructions
     std::vector<bh_instruction> instr_list;
 
@@ -220,6 +267,28 @@ private:
 
     // Number of calls to flush
     uint64_t _flush_count = 0;
+
+    // Execute flushes asynchronously on the executor thread
+    const bool async_flush;
+
+    // Serializes the access to `runtime` between the executor and the calling thread
+    std::mutex runtime_mutex;
+
+    // The flushed jobs that await execution, the number of unfinished jobs, and the bases in flight
+    // (a base appears once per unfinished job that accesses it). All guarded by `queue_mutex`.
+    std::deque<FlushJob> flush_queue;
+    uint64_t num_pending_jobs = 0;
+    std::multiset<const bh_base *> in_flight;
+    std::exception_ptr executor_error;
+    bool executor_stop = false;
+    std::mutex queue_mutex;
+    // Signals new jobs to the executor thread
+    std::condition_variable job_cond;
+    // Signals finished jobs to waiting threads
+    std::condition_variable done_cond;
+
+    // The executor thread
+    std::thread executor;
 };
 
 //
@@ -251,6 +320,7 @@ void Runtime::enqueueExtmethod(const std::string &name, BhArray<T> &out, BhArray
     } else {
         // Add it and tell rest of Bohrium about this new extmethod
         opcode = extmethod_next_opcode_id++;
+        std::lock_guard<std::mutex> guard(runtime_mutex);
         runtime.extmethod(name.c_str(), opcode);
         extmethods.insert(std::pair<std::string, bh_opcode>(name, opcode));
     }
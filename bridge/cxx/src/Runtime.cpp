@@ -28,7 +28,32 @@ namespace bhxx {
 Runtime::Runtime()
       : config(-1),                                // stack level -1 is the bridge
         runtime(config.getChildLibraryPath(), 0),  // and child is stack level 0
-        extmethod_next_opcode_id(BH_MAX_OPCODE_ID + 1) {}
+        extmethod_next_opcode_id(BH_MAX_OPCODE_ID + 1),
+        async_flush(config.defaultGet<bool>("async_flush", false)) {
+    if (async_flush) {
+        executor = std::thread(&Runtime::executorLoop, this);
+    }
+}
+
+Runtime::~Runtime() {
+    // NB: the destructor runs at program exit, thus we report errors instead of throwing them
+    try {
+        flush();
+        waitAll();
+    } catch (const std::exception &e) {
+        cerr << "[bhxx] the final flush failed: " << e.what() << endl;
+    } catch (...) {
+        cerr << "[bhxx] the final flush failed" << endl;
+    }
+    if (executor.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            executor_stop = true;
+        }
+        job_cond.notify_one();
+        executor.join();
+    }
+}
 
 void Runtime::enqueue(BhInstruction instr) {
     instr_list.push_back(std::move(instr));
@@ -60,6 +85,8 @@ void Runtime::enqueueDeletion(std::unique_ptr<BhBase> base_ptr) {
     if (!base_ptr->ownMemory()) {
         // Externally managed
         // => set it to null to avoid deletion by Bohrium
+        // NB: a flush in flight might still use the data pointer
+        wait(base_ptr.get());
         base_ptr->resetDataPtr();
     }
 
@@ -69,39 +96,135 @@ void Runtime::enqueueDeletion(std::unique_ptr<BhBase> base_ptr) {
     enqueue(std::move(instr));
 }
 
-namespace {
-// Help function to handle flushing
-void _flush(uint64_t nrepeats, const std::shared_ptr<BhBase> &base_ptr,
-            std::vector<bh_instruction> &instr_list,
-            std::set<bh_base *> &syncs,
-            bohrium::component::ComponentFace &runtime,
-            std::vector<std::unique_ptr<BhBase> > &bases_for_deletion,
-            uint64_t &_flush_count) {
+void Runtime::_flush(uint64_t nrepeats, const std::shared_ptr<BhBase> &base_ptr) {
+    if (not async_flush) {
+        {
+            std::lock_guard<std::mutex> guard(runtime_mutex);
+            BhIR bhir(std::move(instr_list), std::move(syncs), nrepeats, base_ptr.get());
+            runtime.execute(&bhir);
+        }
+        instr_list.clear(); // Notice, it is legal to clear a moved collection.
+        syncs.clear();
 
-    if (not base_ptr) { // The pointer isn't initiated
-        BhIR bhir(std::move(instr_list), std::move(syncs), nrepeats);
-        runtime.execute(&bhir);
-    } else {
-        BhIR bhir(std::move(instr_list), std::move(syncs), nrepeats, &(*base_ptr));
-        runtime.execute(&bhir);
+        // Purge the bases we have scheduled for deletion:
+        bases_for_deletion.clear();
+        ++_flush_count;
+        return;
     }
 
-    instr_list.clear(); // Notice, it is legal to clear a moved collection.
-    syncs.clear();
+    // Report the error of an earlier flush before we take over the current batch, which stays
+    // enqueued (including its BH_FREEs) and is sent by the next flush
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        rethrowExecutorError();
+    }
+
+    // The caller needs the sync'ed arrays right away, thus we have to wait for the flush to finish
+    const bool blocking = not syncs.empty();
 
-    // Purge the bases we have scheduled for deletion:
+    FlushJob job;
+    std::set<const bh_base *> bases;
+    for (const bh_instruction &instr: instr_list) {
+        for (const bh_view &view: instr.operand) {
+            if (not view.isConstant()) {
+                bases.insert(view.base);
+            }
+        }
+    }
+    if (base_ptr) {
+        bases.insert(base_ptr.get());
+    }
+    job.bases.assign(bases.begin(), bases.end());
+    job.instr_list = std::move(instr_list);
+    job.syncs = std::move(syncs);
+    job.nrepeats = nrepeats;
+    job.repeat_condition = base_ptr;
+    job.bases_for_deletion = std::move(bases_for_deletion);
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        in_flight.insert(job.bases.begin(), job.bases.end());
+        ++num_pending_jobs;
+        flush_queue.push_back(std::move(job));
+    }
+    job_cond.notify_one();
+
+    instr_list.clear();
+    syncs.clear();
     bases_for_deletion.clear();
     ++_flush_count;
+
+    if (blocking) {
+        waitAll();
+    }
+}
+
+void Runtime::executorLoop() {
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (true) {
+        job_cond.wait(lock, [this] { return executor_stop or not flush_queue.empty(); });
+        if (flush_queue.empty()) { // We are stopping and all jobs are done
+            return;
+        }
+        FlushJob job = std::move(flush_queue.front());
+        flush_queue.pop_front();
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            std::lock_guard<std::mutex> guard(runtime_mutex);
+            BhIR bhir(std::move(job.instr_list), std::move(job.syncs), job.nrepeats, job.repeat_condition.get());
+            runtime.execute(&bhir);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        job.bases_for_deletion.clear();
+        job.repeat_condition.reset();
+
+        lock.lock();
+        if (error and not executor_error) {
+            executor_error = error;
+        }
+        for (const bh_base *base: job.bases) {
+            in_flight.erase(in_flight.find(base));
+        }
+        --num_pending_jobs;
+        done_cond.notify_all();
+    }
 }
+
+void Runtime::rethrowExecutorError() {
+    if (executor_error) {
+        std::exception_ptr error = executor_error;
+        executor_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void Runtime::wait(const bh_base *base) {
+    if (not async_flush) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    done_cond.wait(lock, [this, base] { return in_flight.find(base) == in_flight.end(); });
+    rethrowExecutorError();
+}
+
+void Runtime::waitAll() {
+    if (not async_flush) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    done_cond.wait(lock, [this] { return num_pending_jobs == 0; });
+    rethrowExecutorError();
 }
 
 void Runtime::flush() {
     std::shared_ptr<BhBase> dummy;
-    _flush(1, dummy, instr_list, syncs, runtime, bases_for_deletion, _flush_count);
+    _flush(1, dummy);
 }
 
 void Runtime::flushAndRepeat(uint64_t nrepeats, const std::shared_ptr<BhBase> &base_ptr) {
-    _flush(nrepeats, base_ptr, instr_list, syncs, runtime, bases_for_deletion, _flush_count);
+    _flush(nrepeats, base_ptr);
 }
 
 void Runtime::sync(std::shared_ptr<BhBase> &base_ptr) {
@@ -109,22 +232,29 @@ void Runtime::sync(std::shared_ptr<BhBase> &base_ptr) {
 }
 
 std::string Runtime::message(const std::string &msg) {
+    waitAll();
     return runtime.message(msg);
 }
 
 void* Runtime::getMemoryPointer(std::shared_ptr<BhBase> &base, bool copy2host, bool force_alloc, bool nullify) {
+    wait(base.get());
+    std::lock_guard<std::mutex> guard(runtime_mutex);
     return runtime.getMemoryPointer(*base, copy2host, force_alloc, nullify);
 }
 
 void Runtime::setMemoryPointer(std::shared_ptr<BhBase> &base, bool host_ptr, void *mem) {
+    wait(base.get());
+    std::lock_guard<std::mutex> guard(runtime_mutex);
     return runtime.setMemoryPointer(base.get(), host_ptr, mem);
 }
 
 void* Runtime::getDeviceContext() {
+    waitAll();
     return runtime.getDeviceContext();
 }
 
 void Runtime::setDeviceContext(void *device_context) {
+    waitAll();
     runtime.setDeviceContext(device_context);
 }
 
@@ -134,6 +264,7 @@ std::string Runtime::userKernel(const std::string &kernel, std::vector<BhArrayUn
     for (BhArrayUnTypedCore* op: operand_list) {
         ops.push_back(op->getBhView());
     }
+    waitAll();
     return runtime.userKernel(kernel, ops, compile_cmd, tag, param);
 }
 
@@ -19,12 +19,14 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <string>
+#include <sstream>
 #include <algorithm>
 #include <boost/property_tree/ptree.hpp>
 #include <boost/property_tree/ini_parser.hpp>
 #include <boost/property_tree/exceptions.hpp>
 #include <boost/algorithm/string.hpp>
 #include <cstdlib>
+#include <unistd.h>
 #include <dlfcn.h>
 #include <limits.h>
 #include <bh_config_parser.hpp>
@@ -164,6 +166,17 @@ string lookup_env(const string &section, const string &option) {
 }// namespace unnamed
 
 string ConfigParser::lookup(const string &section, const string &option) const {
+    //Check overrides
+    if (not _overrides.empty() and section == _default_section) {
+        auto it = _overrides.find(option);
+        if (it != _overrides.end()) {
+            return it->second;
+        }
+    }
+    return lookupIgnoringOverrides(section, option);
+}
+
+string ConfigParser::lookupIgnoringOverrides(const string &section, const string &option) const {
     //Check environment variable
     string ret = lookup_env(section, option);
     if (not ret.empty())
@@ -246,6 +259,30 @@ vector<boost::filesystem::path> ConfigParser::getListOfPaths(const std::string &
     return ret;
 }
 
+string ConfigParser::sectionAsString(const std::string &section) const {
+    stringstream ss;
+    const auto options = _config.get_child_optional(section);
+    if (options) {
+        for (const auto &option: *options) {
+            ss << option.first << "=" << lookupIgnoringOverrides(section, option.first) << "\n";
+        }
+    }
+    // Options that only exist as environment variables
+    string prefix = "BH_" + section + "_";
+    to_upper(prefix);
+    vector<string> env_options;
+    for (char **env = environ; *env != nullptr; ++env) {
+        if (starts_with(*env, prefix)) {
+            env_options.emplace_back(*env);
+        }
+    }
+    std::sort(env_options.begin(), env_options.end());
+    for (const string &option: env_options) {
+        ss << option << "\n";
+    }
+    return ss.str();
+}
+
 string ConfigParser::getChildLibraryPath() const {
     // Do we have a child?
     if (static_cast<int>(_stack_list.size()) <= stack_level + 1) {
@@ -22,6 +22,14 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <bh_malloc_cache.hpp>
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <unistd.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#include <unordered_set>
 
 #if defined(__APPLE__) || defined(__MACOSX)
 #include <sys/sysctl.h>
@@ -29,6 +37,10 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <sys/sysinfo.h>
 #endif
 
+#ifndef MAP_POPULATE // Not available on macOS, where the pages are written by `prefault()` instead
+#define MAP_POPULATE 0
+#endif
+
 using namespace std;
 using namespace bohrium;
 
@@ -49,21 +61,137 @@ uint64_t bh_main_memory_total() {
 }
 
 namespace {
-// Allocate page-size aligned main memory.
-void *main_mem_malloc(uint64_t nbytes) {
+// The paging of new allocations (see bh_set_main_memory_paging())
+bh_huge_pages huge_pages = bh_huge_pages::NONE;
+uint64_t huge_pages_threshold = 0;
+uint64_t prefault_threads = 0;
+uint64_t prefault_threshold = 0;
+std::function<void(void *, uint64_t)> placement;
+
+// Allocations backed by the huge page pool, which are mapped and unmapped in whole huge pages
+std::unordered_set<void *> hugetlb_allocations;
+
+uint64_t round_up(uint64_t n, uint64_t multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+uint64_t page_size() {
+    static const uint64_t ret = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return ret;
+}
+
+// Return the size of the default huge pages (2 MB when /proc/meminfo isn't available)
+uint64_t huge_page_size() {
+    static const uint64_t ret = [] {
+        uint64_t size_in_kb = 2048;
+        std::ifstream meminfo("/proc/meminfo");
+        std::string key;
+        while (meminfo >> key) {
+            if (key == "Hugepagesize:") {
+                meminfo >> size_in_kb;
+                break;
+            }
+            meminfo.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        return size_in_kb * 1024;
+    }();
+    return ret;
+}
+
+// Map `nbytes` of anonymous memory with the additional `flags` or return null on failure
+void *anonymous_mmap(uint64_t nbytes, int flags) {
     // The MAP_PRIVATE and MAP_ANONYMOUS flags is not 100% portable. See:
     // <http://stackoverflow.com/questions/4779188/how-to-use-mmap-to-allocate-a-memory-in-heap>
-    void *ret = mmap(0, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-    if (ret == MAP_FAILED or ret == nullptr) {
-        std::stringstream ss;
-        ss << "main_mem_malloc() could not allocate a data region. Returned error code: " << strerror(errno);
-        throw std::runtime_error(ss.str());
+    void *ret = mmap(0, nbytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+    return ret == MAP_FAILED ? nullptr : ret;
+}
+
+// Write each page of `mem` using `nthreads` threads, which makes the kernel back the pages up front instead of
+// faulting them in serially when the first kernel touches them
+void prefault(void *mem, uint64_t nbytes, uint64_t nthreads) {
+    const uint64_t npages = round_up(nbytes, page_size()) / page_size();
+    // Each thread writes a contiguous chunk of at least 1 MB
+    nthreads = std::max(std::min(nthreads, nbytes / (1024 * 1024)), uint64_t{1});
+    const uint64_t chunk = round_up(npages, nthreads) / nthreads;
+    auto touch = [mem, npages, chunk](uint64_t begin) {
+        volatile char *pages = static_cast<volatile char *>(mem);
+        const uint64_t end = std::min(begin + chunk, npages);
+        for (uint64_t i = begin; i < end; ++i) {
+            pages[i * page_size()] = 0; // New anonymous pages are zero anyway
+        }
+    };
+    std::vector<std::thread> threads;
+    for (uint64_t i = 1; i < nthreads; ++i) {
+        threads.emplace_back(touch, i * chunk);
+    }
+    touch(0);
+    for (std::thread &t: threads) {
+        t.join();
+    }
+}
+
+// Allocate page-size aligned main memory.
+void *main_mem_malloc(uint64_t nbytes) {
+    const bool use_huge_pages = huge_pages != bh_huge_pages::NONE and nbytes >= huge_pages_threshold;
+    const bool use_placement = placement and nbytes >= prefault_threshold;
+    const bool use_prefault = not use_placement and prefault_threads > 0 and nbytes >= prefault_threshold;
+    // A single pre-faulting thread is the kernel populating the pages on mmap
+    const int populate = use_prefault and prefault_threads == 1 ? MAP_POPULATE : 0;
+    void *ret = nullptr;
+    bool populated = false;
+#ifdef MAP_HUGETLB
+    if (use_huge_pages and huge_pages == bh_huge_pages::HUGETLB) {
+        ret = anonymous_mmap(round_up(nbytes, huge_page_size()), MAP_HUGETLB | populate);
+        if (ret != nullptr) {
+            hugetlb_allocations.insert(ret);
+            populated = populate != 0;
+        }
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (use_huge_pages and huge_pages == bh_huge_pages::MADVISE) {
+        // Transparent huge pages only back aligned huge pages thus we map an extra huge page and unmap the unaligned
+        // head and tail
+        const uint64_t align = huge_page_size();
+        const uint64_t size = round_up(nbytes, page_size());
+        char *mem = static_cast<char *>(anonymous_mmap(size + align, 0));
+        if (mem != nullptr) {
+            char *aligned = reinterpret_cast<char *>(round_up(reinterpret_cast<uintptr_t>(mem), align));
+            if (aligned != mem) {
+                munmap(mem, static_cast<size_t>(aligned - mem));
+            }
+            munmap(aligned + size, static_cast<size_t>(mem + align - aligned));
+            madvise(aligned, size, MADV_HUGEPAGE); // Fails harmlessly when transparent huge pages are disabled
+            ret = aligned;
+        }
+    }
+#endif
+    if (ret == nullptr) {
+        ret = anonymous_mmap(nbytes, populate);
+        if (ret == nullptr) {
+            std::stringstream ss;
+            ss << "main_mem_malloc() could not allocate a data region. Returned error code: " << strerror(errno);
+            throw std::runtime_error(ss.str());
+        }
+        // The address might belong to a huge page allocation that was freed outside of the malloc cache
+        hugetlb_allocations.erase(ret);
+        populated = populate != 0;
+    }
+    if (use_placement) {
+        placement(ret, nbytes);
+    } else if (use_prefault and not populated) {
+        prefault(ret, nbytes, prefault_threads);
     }
     return ret;
 }
 
 void main_mem_free(void *mem, uint64_t nbytes) {
     assert(mem != nullptr);
+    auto hugetlb = hugetlb_allocations.find(mem);
+    if (hugetlb != hugetlb_allocations.end()) {
+        nbytes = round_up(nbytes, huge_page_size());
+        hugetlb_allocations.erase(hugetlb);
+    }
     if (munmap(mem, nbytes) != 0) {
         std::stringstream ss;
         ss << "main_mem_free() could not free a data region. " << "Returned error code: " << strerror(errno);
@@ -72,26 +200,46 @@ void main_mem_free(void *mem, uint64_t nbytes) {
 }
 
 MallocCache malloc_cache(main_mem_malloc, main_mem_free, 0);
+// The bridge and its asynchronous flush executor might allocate concurrently
+std::mutex malloc_cache_mutex;
 }
 
 void bh_data_malloc(bh_base *base) {
     if (base == nullptr) return;
     if (base->getDataPtr() != nullptr) return;
+    std::lock_guard<std::mutex> guard(malloc_cache_mutex);
     base->resetDataPtr(malloc_cache.alloc(base->nbytes()));
 }
 
 void bh_data_free(bh_base *base) {
     if (base == nullptr) return;
     if (base->getDataPtr() == nullptr) return;
+    std::lock_guard<std::mutex> guard(malloc_cache_mutex);
     malloc_cache.free(base->nbytes(), base->getDataPtr());
     base->resetDataPtr();
 }
 
 void bh_set_malloc_cache_limit(uint64_t nbytes) {
+    std::lock_guard<std::mutex> guard(malloc_cache_mutex);
     malloc_cache.setLimit(nbytes);
 }
 
+void bh_set_main_memory_paging(bh_huge_pages pages, uint64_t pages_threshold,
+                               uint64_t num_prefault_threads, uint64_t min_prefault_nbytes) {
+    std::lock_guard<std::mutex> guard(malloc_cache_mutex);
+    huge_pages = pages;
+    huge_pages_threshold = pages_threshold;
+    prefault_threads = num_prefault_threads;
+    prefault_threshold = min_prefault_nbytes;
+}
+
+void bh_set_main_memory_placement(std::function<void(void *, uint64_t)> func) {
+    std::lock_guard<std::mutex> guard(malloc_cache_mutex);
+    placement = std::move(func);
+}
+
 void bh_get_malloc_cache_stat(uint64_t &cache_lookup, uint64_t &cache_misses, uint64_t &max_memory_usage) {
+    std::lock_guard<std::mutex> guard(malloc_cache_mutex);
     cache_lookup = malloc_cache.getTotalNumLookups();
     cache_misses = malloc_cache.getTotalNumMisses();
     max_memory_usage = malloc_cache.getMaxMemAllocated();
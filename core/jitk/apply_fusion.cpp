@@ -22,6 +22,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <jitk/apply_fusion.hpp>
 #include <jitk/graph.hpp>
+#include <jitk/cost_model.hpp>
 
 using namespace std;
 
@@ -55,6 +56,15 @@ void apply_transformers(const ConfigParser &config, vector<Block> &block_list, c
             split_for_threading(block_list);
         } else if (*it == "collapse_redundant_axes") {
             collapse_redundant_axes(block_list);
+        } else if (*it == "interchange") {
+            interchange_loops(block_list);
+        } else if (*it == "licm") {
+            hoist_loop_invariants(block_list);
+        } else if (*it == "tile") {
+            // The tiles should fit the L2 cache of a core (unless `tile_cache_size` is set) and be threadable
+            const MachineCostModel::Machine machine = MachineCostModel::getMachine(config);
+            const uint64_t cache_size = config.defaultGet<uint64_t>("tile_cache_size", 0);
+            tile(block_list, cache_size > 0 ? cache_size : machine.l2_size, machine.num_cores);
         } else if (*it == "serial") {
             fuser_serial(block_list, avoid_rank0_sweep);
         } else if (*it == "breadth_first") {
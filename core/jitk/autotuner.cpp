@@ -0,0 +1,223 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <limits>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/filesystem/operations.hpp>
+#include <boost/algorithm/string/join.hpp>
+
+#include <bh_util.hpp>
+#include <bh_version.h>
+#include <jitk/autotuner.hpp>
+#include <jitk/codegen_util.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+
+// The boolean options that a variant can flip and their default values, which must match the ones of the engines
+const map<string, bool> bool_options = {
+        {"monolithic",               true},
+        {"strides_as_var",           true},
+        {"index_as_var",             true},
+        {"index_strength_reduction", false},
+        {"const_as_var",             true},
+        {"compiler_openmp_simd",     false},
+        {"unit_stride_fastpath",     false},
+        {"stencil_register_reuse",   false}
+};
+
+// The header of the persistent file, which must be changed when the format changes. It includes the Bohrium
+// version since the variants might perform differently in another version
+const string FILE_HEADER = string("bohrium-autotune-1 ") + BH_VERSION_STRING;
+
+// Return the alternative value of the non-boolean `option` or the empty string when there is no alternative
+string alternative(const ConfigParser &config, const string &option) {
+    if (option == "fuser_list") {
+        // Replace the greedy fuser with the reshapable first fuser or vice versa
+        vector<string> fusers = config.defaultGetList(option, {"greedy"});
+        for (string &fuser: fusers) {
+            if (fuser == "greedy") {
+                fuser = "reshapable_first";
+                return boost::algorithm::join(fusers, ",");
+            } else if (fuser == "reshapable_first") {
+                fuser = "greedy";
+                return boost::algorithm::join(fusers, ",");
+            }
+        }
+        return "";
+    } else if (option == "pre_fuser") {
+        const string pre_fuser = config.defaultGet<string>(option, "pre_fuser_lossy");
+        return (pre_fuser == "lossy" or pre_fuser == "pre_fuser_lossy") ? "none" : "lossy";
+    } else if (option == "fuser_cost_model") {
+        return config.defaultGet<string>(option, "bytes") == "bytes" ? "machine" : "bytes";
+    }
+    throw runtime_error("Autotuner: cannot vary the option '" + option + "'");
+}
+} // Anon namespace
+
+Autotuner::Autotuner(const ConfigParser &config, bool verbose) :
+        _enabled(config.defaultGet<bool>("autotune", false)),
+        _threshold(config.defaultGet<uint64_t>("autotune_threshold", 10)),
+        _runs(std::max(config.defaultGet<uint64_t>("autotune_runs", 3), uint64_t{1})),
+        _verbose(verbose) {
+    Variant baseline;
+    baseline.name = "baseline";
+    _variants.push_back(std::move(baseline));
+    if (not _enabled) {
+        return;
+    }
+    for (const string &option: config.defaultGetList("autotune_variants", {})) {
+        string value;
+        auto it = bool_options.find(option);
+        if (it != bool_options.end()) {
+            value = config.defaultGet<bool>(option, it->second) ? "false" : "true";
+        } else {
+            value = alternative(config, option);
+        }
+        if (not value.empty()) {
+            Variant variant;
+            variant.name = option + "=" + value;
+            variant.options[option] = value;
+            variant.hash = util::hash(variant.name);
+            _variants.push_back(std::move(variant));
+        }
+    }
+}
+
+const Autotuner::Variant &Autotuner::select(uint64_t instr_list_hash) {
+    if (not _enabled) {
+        return _variants[0];
+    }
+    if (not _loaded) {
+        load();
+    }
+    auto it = _entries.find(instr_list_hash);
+    if (it == _entries.end()) {
+        return _variants[0];
+    }
+    const Entry &entry = it->second;
+    if (entry.pinned >= 0) {
+        return _variants[entry.pinned];
+    }
+    if (entry.executions < _threshold) {
+        return _variants[0];
+    }
+    return _variants[entry.current];
+}
+
+void Autotuner::record(uint64_t instr_list_hash, const Variant &variant, double seconds) {
+    if (not _enabled) {
+        return;
+    }
+    Entry &entry = _entries[instr_list_hash];
+    if (entry.pinned >= 0) {
+        return;
+    }
+    if (entry.executions < _threshold) {
+        ++entry.executions;
+        return;
+    }
+    if (&variant != &_variants[entry.current]) {
+        return;
+    }
+    // The first execution of a variant is a warm-up, which includes fusion, codegen, and compilation
+    if (entry.trials++ > 0) {
+        entry.best_times.resize(entry.current + 1, numeric_limits<double>::infinity());
+        entry.best_times[entry.current] = std::min(entry.best_times[entry.current], seconds);
+    }
+    if (entry.trials > _runs) {
+        entry.trials = 0;
+        if (++entry.current == _variants.size()) {
+            pin(instr_list_hash, entry);
+        }
+    }
+}
+
+void Autotuner::pin(uint64_t instr_list_hash, Entry &entry) {
+    const auto fastest = std::min_element(entry.best_times.begin(), entry.best_times.end());
+    entry.pinned = fastest - entry.best_times.begin();
+    entry.best_times.clear();
+    _dirty = true;
+    if (_verbose) {
+        cout << "[autotune] instruction list " << std::hex << instr_list_hash << std::dec << ": pinned '"
+             << _variants[entry.pinned].name << "' (" << *fastest << " sec)" << endl;
+    }
+}
+
+void Autotuner::load() {
+    _loaded = true;
+    if (_file.empty() or not boost::filesystem::exists(_file)) {
+        return;
+    }
+    ifstream ifs(_file.string());
+    string line;
+    if (not getline(ifs, line) or line != FILE_HEADER) {
+        return;
+    }
+    map<string, int64_t> name2index;
+    for (size_t i = 0; i < _variants.size(); ++i) {
+        name2index[_variants[i].name] = i;
+    }
+    // Each line is "<instruction list hash> <variant name>"
+    while (getline(ifs, line)) {
+        stringstream ss(line);
+        uint64_t instr_list_hash;
+        string name;
+        if (not (ss >> std::hex >> instr_list_hash >> name)) {
+            continue;
+        }
+        auto it = name2index.find(name);
+        if (it == name2index.end()) {
+            continue; // The variant isn't tried by this configuration
+        }
+        // NB: variants already pinned take precedence
+        Entry &entry = _entries[instr_list_hash];
+        if (entry.pinned < 0) {
+            entry.pinned = it->second;
+        }
+    }
+}
+
+void Autotuner::save() {
+    if (_file.empty() or not _dirty) {
+        return;
+    }
+    load(); // Let's include the variants other processes have pinned since we loaded the file
+    stringstream ss;
+    ss << FILE_HEADER << "\n";
+    for (const auto &entry: _entries) {
+        if (entry.second.pinned >= 0) {
+            ss << std::hex << entry.first << std::dec << " " << _variants[entry.second.pinned].name << "\n";
+        }
+    }
+    write_file_atomically(ss.str(), _file);
+    _dirty = false;
+}
+
+} // jitk
+} // bohrium
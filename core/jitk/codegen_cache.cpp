@@ -20,8 +20,16 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <iostream>
-
+#include <fstream>
+#include <boost/filesystem/operations.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <bh_version.h>
 #include <jitk/codegen_cache.hpp>
+#include <jitk/codegen_util.hpp>
 
 using namespace std;
 
@@ -39,6 +47,9 @@ void hash_stream(const bh_view &view, const SymbolTable &symbols, std::stringstr
 
     if (symbols.strides_as_var) {
         ss << "strideid: " << symbols.offsetStridesID(view);
+        if (symbols.stencil_reuse) { // The stencils are found using the offsets
+            ss << "vstart: " << view.start;
+        }
     } else {
         ss << "vstart: " << view.start;
         for (int j = 0; j < view.ndim; ++j) {
@@ -109,11 +120,17 @@ uint64_t hash_stream(const LoopB &block, const SymbolTable &symbols) {
     hash_stream(block, symbols, ss);
     return util::hash(ss.str());
 }
+
+// The version of the persistent cache format, which must be incremented when the format changes
+constexpr uint32_t FILE_VERSION = 2;
 } // Anonymous Namespace
 
 std::pair<std::string, uint64_t> CodegenCache::lookup(const LoopB &kernel, const SymbolTable &symbols) {
+    if (not _loaded) {
+        load();
+    }
     ++stat.codegen_cache_lookups;
-    const uint64_t lookup_hash = hash_stream(kernel, symbols);
+    const uint64_t lookup_hash = hash_stream(kernel, symbols) ^ _variant;
     auto lookup = _cache.find(lookup_hash);
     if (lookup != _cache.end()) { // Cache hit!
         return make_pair(lookup->second, lookup_hash);
@@ -124,9 +141,50 @@ std::pair<std::string, uint64_t> CodegenCache::lookup(const LoopB &kernel, const
 }
 
 void CodegenCache::insert(std::string source, const LoopB &kernel, const SymbolTable &symbols) {
-    const uint64_t lookup_hash = hash_stream(kernel, symbols);
+    const uint64_t lookup_hash = hash_stream(kernel, symbols) ^ _variant;
     assert(_cache.find(lookup_hash) == _cache.end()); // The source shouldn't exist in the cache already
     _cache[lookup_hash] = std::move(source);
+    _dirty = true;
+}
+
+void CodegenCache::load() {
+    _loaded = true;
+    if (_file.empty() or not boost::filesystem::exists(_file)) {
+        return;
+    }
+    try {
+        ifstream ifs(_file.string(), ios::binary);
+        boost::archive::binary_iarchive ia(ifs);
+        uint32_t version;
+        ia >> version;
+        string bh_version;
+        ia >> bh_version;
+        if (version != FILE_VERSION or bh_version != BH_VERSION_STRING) {
+            return; // Written by another version of Bohrium, which might generate code differently
+        }
+        std::map<size_t, std::string> entries;
+        ia >> entries;
+        // NB: entries already in the cache take precedence
+        _cache.insert(entries.begin(), entries.end());
+    } catch (const std::exception &e) {
+        cout << "Warning: ignoring the codegen cache " << _file << ". " << e.what() << endl;
+    }
+}
+
+void CodegenCache::save() {
+    if (_file.empty() or not _dirty) {
+        return;
+    }
+    load(); // Let's include the entries other processes have written since we loaded the file
+    stringstream ss;
+    {
+        boost::archive::binary_oarchive oa(ss);
+        oa << FILE_VERSION;
+        oa << string(BH_VERSION_STRING);
+        oa << _cache;
+    }
+    write_file_atomically(ss.str(), _file);
+    _dirty = false;
 }
 
 } // jitk
@@ -73,6 +73,19 @@ boost::filesystem::path get_tmp_path(const ConfigParser &config) {
     return tmp_path / unique_path;
 }
 
+void write_file_atomically(const std::string &content, const boost::filesystem::path &file) {
+    const boost::filesystem::path tmp = file.string() + boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp").string();
+    {
+        ofstream ofs(tmp.string(), ios::binary);
+        ofs << content;
+        if (not ofs) {
+            boost::filesystem::remove(tmp);
+            throw runtime_error("Couldn't write " + tmp.string());
+        }
+    }
+    boost::filesystem::rename(tmp, file);
+}
+
 void create_directories(const boost::filesystem::path &path) {
     constexpr int tries = 5;
     for (int i = 1; i <= tries; ++i) {
@@ -0,0 +1,201 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <stdexcept>
+#include <unistd.h>
+
+#include <jitk/cost_model.hpp>
+#include <jitk/iterator.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+// The bandwidth in bytes per cycle of the caches (per core) and the main memory (shared by all cores)
+constexpr double L1_BANDWIDTH = 64;
+constexpr double L2_BANDWIDTH = 32;
+constexpr double L3_BANDWIDTH = 16;
+constexpr double DRAM_BANDWIDTH = 16;
+// The number of concurrent streams the hardware prefetchers handle well
+constexpr double MAX_STREAMS = 16;
+// The number of (vector) registers available to the kernel
+constexpr double NUM_REGISTERS = 16;
+// The cycles it takes an instruction to compute an element (assuming vectorization)
+constexpr double CYCLES_PER_ELEMENT = 0.25;
+// The cycles it takes to launch a kernel or a parallel loop (incl. the fork/join of threads)
+constexpr double LAUNCH_OVERHEAD = 5000;
+
+// Return the bytes of the arrays created in `a` and freed in `b`
+uint64_t contracted_bytes(const BlockProfile &a, const BlockProfile &b) {
+    // We search the smallest set
+    const bool news_smallest = a.news.size() < b.frees.size();
+    const set<bh_base *> &smallest = news_smallest ? a.news : b.frees;
+    const set<bh_base *> &largest = news_smallest ? b.frees : a.news;
+    uint64_t ret = 0;
+    for (bh_base *base: smallest) {
+        if (largest.find(base) != largest.end()) {
+            ret += base->nbytes();
+        }
+    }
+    return ret;
+}
+
+// Return `value` if non-zero otherwise the result of `sysconf(name)` or `fallback` if that fails
+uint64_t detect(uint64_t value, int name, uint64_t fallback) {
+    if (value > 0) {
+        return value;
+    }
+    const long ret = sysconf(name);
+    return ret > 0 ? static_cast<uint64_t>(ret) : fallback;
+}
+} // Anon namespace
+
+BlockProfile::BlockProfile(const LoopB &block) {
+    for (const InstrPtr &instr: iterator::allInstr(block)) {
+        for (const bh_view &view: instr->getViews()) {
+            bases.insert(view.base);
+        }
+        if (not bh_opcode_is_system(instr->opcode)) {
+            ++num_instrs;
+            num_elements += static_cast<uint64_t>(instr->shape().prod());
+        }
+    }
+    block.getAllNews(news);
+    block.getAllFrees(frees);
+    parallelism = parallel_ranks(block).second;
+}
+
+void BlockProfile::merge(const BlockProfile &other) {
+    bases.insert(other.bases.begin(), other.bases.end());
+    news.insert(other.news.begin(), other.news.end());
+    frees.insert(other.frees.begin(), other.frees.end());
+    num_instrs += other.num_instrs;
+    num_elements += other.num_elements;
+    parallelism = std::min(parallelism, other.parallelism);
+}
+
+double BytesCostModel::benefit(const BlockProfile &a, const BlockProfile &b) const {
+    return static_cast<double>(contracted_bytes(a, b));
+}
+
+MachineCostModel::Machine MachineCostModel::getMachine(const ConfigParser &config) {
+    Machine ret;
+    ret.l1_size = detect(config.defaultGet<uint64_t>("cost_model_l1_size", 0), _SC_LEVEL1_DCACHE_SIZE, 32 * 1024);
+    ret.l2_size = detect(config.defaultGet<uint64_t>("cost_model_l2_size", 0), _SC_LEVEL2_CACHE_SIZE, 1024 * 1024);
+    ret.l3_size = detect(config.defaultGet<uint64_t>("cost_model_l3_size", 0), _SC_LEVEL3_CACHE_SIZE,
+                         8 * 1024 * 1024);
+    ret.num_cores = config.defaultGet<uint64_t>("cost_model_num_cores", 0);
+    if (ret.num_cores == 0) {
+        ret.num_cores = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    return ret;
+}
+
+namespace {
+// The bytes of the non-temporary arrays, which make up the memory traffic, the number of non-temporary arrays
+// (the streams), and the number of arrays of the merge of `a` and `b` (`b` might be null)
+struct Footprint {
+    uint64_t traffic = 0, num_streams = 0, num_bases = 0;
+
+    Footprint(const BlockProfile &a, const BlockProfile *b) {
+        const auto in = [](const set<bh_base *> &s, bh_base *base) { return s.find(base) != s.end(); };
+        const auto add = [&](bh_base *base) {
+            ++num_bases;
+            const bool is_new = in(a.news, base) or (b != nullptr and in(b->news, base));
+            const bool is_freed = in(a.frees, base) or (b != nullptr and in(b->frees, base));
+            if (not (is_new and is_freed)) {
+                traffic += base->nbytes();
+                ++num_streams;
+            }
+        };
+        for (bh_base *base: a.bases) {
+            add(base);
+        }
+        if (b != nullptr) {
+            for (bh_base *base: b->bases) {
+                if (not in(a.bases, base)) {
+                    add(base);
+                }
+            }
+        }
+    }
+};
+
+// Return the estimated cost of a block with the given footprint, number of computed elements, and parallelism
+double estimate_cost(const MachineCostModel::Machine &machine, const Footprint &footprint, uint64_t num_elements,
+                     uint64_t parallelism) {
+    const double cores = static_cast<double>(std::max(std::min(machine.num_cores, parallelism), uint64_t{1}));
+
+    // The bandwidth depends on the cache level that the working set fits in
+    double bandwidth;
+    if (footprint.traffic <= machine.l1_size * cores) {
+        bandwidth = L1_BANDWIDTH * cores;
+    } else if (footprint.traffic <= machine.l2_size * cores) {
+        bandwidth = L2_BANDWIDTH * cores;
+    } else if (footprint.traffic <= machine.l3_size) {
+        bandwidth = L3_BANDWIDTH * cores;
+    } else {
+        bandwidth = DRAM_BANDWIDTH;
+    }
+    double memory = footprint.traffic / bandwidth;
+    if (footprint.num_streams > MAX_STREAMS) {
+        memory *= footprint.num_streams / MAX_STREAMS;
+    }
+
+    double compute = num_elements * CYCLES_PER_ELEMENT / cores;
+    if (footprint.num_bases > NUM_REGISTERS) {
+        compute *= footprint.num_bases / NUM_REGISTERS;
+    }
+    return std::max(memory, compute) + LAUNCH_OVERHEAD;
+}
+} // Anon namespace
+
+double MachineCostModel::cost(const BlockProfile &block) const {
+    return estimate_cost(_machine, Footprint(block, nullptr), block.num_elements, block.parallelism);
+}
+
+double MachineCostModel::cost(const BlockProfile &a, const BlockProfile &b) const {
+    return estimate_cost(_machine, Footprint(a, &b), a.num_elements + b.num_elements,
+                         std::min(a.parallelism, b.parallelism));
+}
+
+double MachineCostModel::benefit(const BlockProfile &a, const BlockProfile &b) const {
+    return cost(a) + cost(b) - cost(a, b);
+}
+
+unique_ptr<FusionCostModel> create_cost_model(const ConfigParser &config) {
+    const string name = config.defaultGet<string>("fuser_cost_model", "bytes");
+    if (name == "bytes") {
+        return unique_ptr<FusionCostModel>(new BytesCostModel());
+    } else if (name == "machine") {
+        return unique_ptr<FusionCostModel>(new MachineCostModel(MachineCostModel::getMachine(config)));
+    } else {
+        cout << "Unknown fuser cost model: \"" << name << "\"" << endl;
+        throw runtime_error("Unknown fuser cost model!");
+    }
+}
+
+} // jitk
+} // bohrium
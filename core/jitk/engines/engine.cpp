@@ -18,6 +18,8 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include <jitk/engines/engine.hpp>
 
 using namespace std;
@@ -25,6 +27,16 @@ using namespace std;
 namespace bohrium {
 namespace jitk {
 
+Engine::~Engine() {
+    try {
+        fcache.save();
+        codegen_cache.save();
+        autotuner.save();
+    } catch (const std::exception &e) {
+        cout << "Warning: couldn't write the persistent caches to " << cache_bin_dir << ". " << e.what() << endl;
+    }
+}
+
 namespace { // We need some help functions
 
 /// Help function for writing variable subscription
@@ -41,6 +53,208 @@ string get_name_and_subscription(const Scope &scope, const bh_view &view) {
     get_name_and_subscription(scope, view, ss);
     return ss.str();
 }
+
+// The maximum distance (in iterations) between the first and last view of a stencil group
+constexpr int64_t MAX_STENCIL_REACH = 4;
+
+/* Return the groups of views in the innermost loop `block` that read the same base array at consecutive offsets along
+ * the loop axis, e.g. `a[:-2]`, `a[1:-1]`, and `a[2:]`. The views of a group have identical shape and strides and the
+ * i'th view of a group reads the element that the first view reads `i` iterations later. Arrays written within the
+ * loop are never part of a group. */
+vector<vector<bh_view> > stencil_groups(const Scope &scope, const LoopB &block) {
+    set<const bh_base *> written;
+    vector<vector<bh_view> > groups;
+    for (const InstrPtr &instr: iterator::allInstr(block)) {
+        if (instr->operand.empty()) {
+            continue;
+        }
+        written.insert(instr->operand[0].base);
+        if (bh_opcode_is_accumulate(instr->opcode) or instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER or
+            instr->opcode == BH_COND_SCATTER) {
+            continue;
+        }
+        for (size_t i = 1; i < instr->operand.size(); ++i) {
+            const bh_view &view = instr->operand[i];
+            if (view.isConstant() or view.is_scalar() or view.ndim <= block.rank or not scope.isArray(view) or
+                scope.symbols.isAlwaysArray(view.base) or not scope.symbols.existOffsetStridesID(view)) {
+                continue;
+            }
+            bool found = false;
+            for (vector<bh_view> &group: groups) {
+                const bh_view &first = group.front();
+                if (first.base == view.base and first.shape == view.shape and first.stride == view.stride) {
+                    if (std::find(group.begin(), group.end(), view) == group.end()) {
+                        group.push_back(view);
+                    }
+                    found = true;
+                    break;
+                }
+            }
+            if (not found) {
+                groups.push_back({view});
+            }
+        }
+    }
+
+    vector<vector<bh_view> > ret;
+    for (vector<bh_view> &group: groups) {
+        const int64_t stride = group.front().stride[block.rank];
+        if (group.size() < 2 or stride == 0 or util::exist(written, group.front().base)) {
+            continue;
+        }
+        // Let's order the views along the loop axis and split them into chains of consecutive offsets
+        std::sort(group.begin(), group.end(), [stride](const bh_view &v1, const bh_view &v2) {
+            return stride > 0 ? v1.start < v2.start : v1.start > v2.start;
+        });
+        vector<bh_view> chain;
+        for (const bh_view &view: group) {
+            if (not chain.empty() and (view.start - chain.back().start != stride or
+                                       static_cast<int64_t>(chain.size()) > MAX_STENCIL_REACH)) {
+                if (chain.size() > 1) {
+                    ret.push_back(std::move(chain));
+                }
+                chain.clear();
+            }
+            chain.push_back(view);
+        }
+        if (chain.size() > 1) {
+            ret.push_back(std::move(chain));
+        }
+    }
+    return ret;
+}
+
+// Write the runtime check that the views of each stencil group in `groups` are at consecutive offsets along `block`
+void write_stencil_guard(const SymbolTable &symbols, const LoopB &block, const vector<vector<bh_view> > &groups,
+                         stringstream &out) {
+    bool first_cond = true;
+    for (const vector<bh_view> &group: groups) {
+        const size_t first = symbols.offsetStridesID(group.front());
+        for (size_t i = 1; i < group.size(); ++i) {
+            const size_t id = symbols.offsetStridesID(group[i]);
+            if (not first_cond) {
+                out << " && ";
+            }
+            first_cond = false;
+            out << "vo" << id << " == vo" << first << " + " << i << "*vs" << first << "_" << block.rank;
+            for (int64_t j = 0; j < group[i].ndim; ++j) {
+                out << " && vs" << id << "_" << j << " == vs" << first << "_" << j;
+            }
+        }
+    }
+}
+
+/* Return the stride variables (e.g. `vs3_1`) of the arrays in the innermost loop `block` that multiply the
+ * loop iterator. When they are all one at runtime, the loop accesses contiguous memory and we can write a copy of the
+ * loop where the strides are the constant one, which the compiler vectorizes.
+ * Returns the empty set when the loop doesn't support such a unit-stride fast path. */
+set<string> unit_stride_variables(const Scope &scope, const LoopB &block) {
+    set<string> ret;
+    if (not scope.symbols.strides_as_var) {
+        return ret;
+    }
+    for (const InstrPtr &instr: iterator::allInstr(block)) {
+        // Accumulations carries a dependency between iterations and gather/scatter access memory non-contiguously
+        if (bh_opcode_is_accumulate(instr->opcode) or instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER or
+            instr->opcode == BH_COND_SCATTER) {
+            return {};
+        }
+        for (size_t i = 0; i < instr->operand.size(); ++i) {
+            const bh_view &view = instr->operand[i];
+            if (view.isConstant()) {
+                continue;
+            }
+            // If the output is also accessed through another view, the iterations might overlap
+            if (i == 0) {
+                for (const InstrPtr &other: iterator::allInstr(block)) {
+                    for (const bh_view &v: other->getViews()) {
+                        if (v.base == view.base and not(v == view)) {
+                            return {};
+                        }
+                    }
+                }
+            }
+            if (view.is_scalar() or not scope.isArray(view) or not scope.symbols.existOffsetStridesID(view)) {
+                continue;
+            }
+            // Find the dimension of `view` that the loop iterates, which is shifted by the hidden axis of reductions
+            int dim = block.rank;
+            if (i == 0 and bh_opcode_is_reduction(instr->opcode)) {
+                const int hidden_axis = instr->sweep_axis();
+                if (hidden_axis == block.rank) {
+                    continue; // The output doesn't depend on the iterator
+                } else if (hidden_axis < block.rank) {
+                    --dim;
+                }
+            }
+            if (dim < view.ndim) {
+                stringstream ss;
+                ss << "vs" << scope.symbols.offsetStridesID(view) << "_" << dim;
+                ret.insert(ss.str());
+            }
+        }
+    }
+    return ret;
+}
+/* Return the reductions of the innermost loop `block` that can use multiple partial accumulators, which are the
+ * reductions over the loop axis into scalar-replaced outputs. Returns the empty vector when a sweep of the loop
+ * doesn't support partial accumulators or when an output is accessed by other instructions in the loop. */
+vector<InstrPtr> accumulator_reductions(const Scope &scope, const LoopB &block) {
+    vector<InstrPtr> ret;
+    for (const InstrPtr &instr: iterator::allInstr(block)) {
+        if (bh_opcode_is_accumulate(instr->opcode)) {
+            return {};
+        }
+        if (not bh_opcode_is_reduction(instr->opcode)) {
+            continue;
+        }
+        switch (instr->opcode) {
+            case BH_ADD_REDUCE:
+            case BH_MULTIPLY_REDUCE:
+            case BH_MINIMUM_REDUCE:
+            case BH_MAXIMUM_REDUCE:
+            case BH_LOGICAL_AND_REDUCE:
+            case BH_LOGICAL_OR_REDUCE:
+            case BH_LOGICAL_XOR_REDUCE:
+            case BH_BITWISE_AND_REDUCE:
+            case BH_BITWISE_OR_REDUCE:
+            case BH_BITWISE_XOR_REDUCE:
+                break;
+            default:
+                return {};
+        }
+        if (instr->sweep_axis() != block.rank or not sweeping_innermost_axis(instr) or
+            not scope.isScalarReplaced(instr->operand[0])) {
+            return {};
+        }
+        ret.push_back(instr);
+    }
+    // The partial accumulators only hold the result after the loop, thus no other access of the outputs is allowed
+    for (const InstrPtr &reduction: ret) {
+        for (const InstrPtr &instr: iterator::allInstr(block)) {
+            for (size_t i = 0; i < instr->operand.size(); ++i) {
+                const bh_view &view = instr->operand[i];
+                if (not view.isConstant() and view.base == reduction->operand[0].base and
+                    not(instr == reduction and i == 0)) {
+                    return {};
+                }
+            }
+        }
+    }
+    return ret;
+}
+
+// Return the number of partial accumulators that hides the latency of the arithmetic of `reductions`
+int default_num_accumulators(const vector<InstrPtr> &reductions) {
+    int ret = 2;
+    for (const InstrPtr &instr: reductions) {
+        const bh_type dtype = instr->operand[0].base->dtype();
+        if (bh_type_is_float(dtype) or bh_type_is_complex(dtype)) {
+            ret = 4;
+        }
+    }
+    return ret;
+}
 }
 
 void Engine::writeKernelFunctionArguments(const jitk::SymbolTable &symbols,
@@ -132,6 +346,37 @@ void Engine::writeBlock(const SymbolTable &symbols,
         }
     }
 
+    // Declare the partial indexes of the arrays accessed by the child blocks, which makes the index calculation of
+    // each block add the terms of its own axis only (strength reduction of the index calculations)
+    if (kernel.rank >= 0 and not opencl and symbols.index_as_var and
+        comp.config.defaultGet<bool>("index_strength_reduction", false)) {
+        const set<bh_base *> temps = kernel.getAllTemps();
+        for (const Block &b: kernel._block_list) {
+            if (b.isInstr()) {
+                continue;
+            }
+            for (const InstrPtr &instr: iterator::allInstr(b.getLoop())) {
+                // The index of accumulations and the gathered/scattered arrays aren't calculated by the loop axes
+                if (bh_opcode_is_accumulate(instr->opcode) or instr->opcode == BH_GATHER or
+                    instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+                    continue;
+                }
+                for (size_t i = 0; i < instr->operand.size(); ++i) {
+                    const bh_view &view = instr->operand[i];
+                    if (view.isConstant() or view.is_scalar() or view.ndim <= kernel.rank or
+                        util::exist(temps, view.base) or not scope.isArray(view) or
+                        (i == 0 and bh_opcode_is_reduction(instr->opcode)) or
+                        scope.partialIdxRank(view) >= kernel.rank) {
+                        continue;
+                    }
+                    util::spaces(out, 8 + kernel.rank * 4);
+                    scope.writePartialIdxDeclaration(view, writeType(bh_type::UINT64), kernel.rank, out);
+                    out << "\n";
+                }
+            }
+        }
+    }
+
     // Declare scalar replacement of outputs that reduces over the innermost axis in the child block
     {
         for (const jitk::Block &b1: kernel._block_list) {
@@ -217,11 +462,90 @@ void Engine::writeBlock(const SymbolTable &symbols,
                 writeInstr(scope, *instr, 4 + b.rank() * 4, opencl, out);
             }
         } else {
-            util::spaces(out, 4 + b.rank() * 4);
-            loopHeadWriter(symbols, scope, b.getLoop(), thread_stack, out);
-            writeBlock(symbols, &scope, b.getLoop(), thread_stack, opencl, out);
-            util::spaces(out, 4 + b.rank() * 4);
-            out << "}\n";
+            const LoopB &loop = b.getLoop();
+            if (not opencl and loopWriter(symbols, scope, loop, thread_stack, out)) {
+                continue;
+            }
+            loopPrologueWriter(symbols, scope, loop, out);
+            // Stencils in sequential innermost loops reuse their loads through rotating registers. When the strides
+            // are variables, the offsets of the views are checked at runtime.
+            vector<vector<bh_view> > stencils;
+            if (not opencl and loop.isInnermost() and loop.rank > 0 and symbols.stencil_reuse) {
+                stencils = stencil_groups(scope, loop);
+            }
+            const bool stencil_guard = not stencils.empty() and symbols.strides_as_var;
+            if (stencil_guard) {
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "if (";
+                write_stencil_guard(symbols, loop, stencils, out);
+                out << ") { // Stencil register reuse\n";
+            }
+            if (not stencils.empty()) {
+                writeStencilLoop(symbols, scope, loop, stencils, thread_stack, out);
+                if (not stencil_guard) {
+                    loopEpilogueWriter(symbols, scope, loop, out);
+                    continue;
+                }
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "} else {\n";
+            }
+            set<string> unit_strides;
+            if (not opencl and loop.isInnermost() and comp.config.defaultGet<bool>("unit_stride_fastpath", false)) {
+                unit_strides = unit_stride_variables(scope, loop);
+            }
+            if (not unit_strides.empty()) {
+                // Let's write the unit-stride fast path, which shadows the stride variables with the constant one
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "if (";
+                for (auto it = unit_strides.begin(); it != unit_strides.end(); ++it) {
+                    if (it != unit_strides.begin()) {
+                        out << " && ";
+                    }
+                    out << *it << " == 1";
+                }
+                out << ") { // Unit-stride fast path\n";
+                for (const string &stride: unit_strides) {
+                    util::spaces(out, 8 + b.rank() * 4);
+                    out << "const " << writeType(bh_type::UINT64) << " " << stride << " = 1;\n";
+                }
+                Scope fastpath_scope(symbols, &scope);
+                util::spaces(out, 4 + b.rank() * 4);
+                loopHeadWriter(symbols, fastpath_scope, loop, thread_stack, out);
+                writeBlock(symbols, &fastpath_scope, loop, thread_stack, opencl, out);
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "}\n";
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "} else { // Strided path\n";
+            }
+            // Reductions in sequential innermost loops update multiple partial accumulators, which breaks the
+            // dependency chain through the reduction variable
+            vector<InstrPtr> reductions;
+            int num_accumulators = 1;
+            if (not opencl and loop.isInnermost() and loop.rank > 0) {
+                reductions = accumulator_reductions(scope, loop);
+                num_accumulators = comp.config.defaultGet<int>("reduction_accumulators", 0);
+                if (num_accumulators <= 0) {
+                    num_accumulators = default_num_accumulators(reductions);
+                }
+            }
+            if (not reductions.empty() and num_accumulators > 1 and loop.size >= 2 * num_accumulators) {
+                writeAccumulatorLoop(symbols, scope, loop, reductions, num_accumulators, thread_stack, out);
+            } else {
+                util::spaces(out, 4 + b.rank() * 4);
+                loopHeadWriter(symbols, scope, loop, thread_stack, out);
+                writeBlock(symbols, &scope, loop, thread_stack, opencl, out);
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "}\n";
+            }
+            if (not unit_strides.empty()) {
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "}\n";
+            }
+            if (stencil_guard) {
+                util::spaces(out, 4 + b.rank() * 4);
+                out << "}\n";
+            }
+            loopEpilogueWriter(symbols, scope, loop, out);
         }
     }
 
@@ -248,6 +572,136 @@ void Engine::writeBlock(const SymbolTable &symbols,
     }
 }
 
+void Engine::writeStencilLoop(const SymbolTable &symbols,
+                              const Scope &scope,
+                              const LoopB &loop,
+                              const vector<vector<bh_view> > &stencil_groups,
+                              const vector<uint64_t> &thread_stack,
+                              stringstream &out) {
+    const int indent = 4 + loop.rank * 4;
+    Scope stencil_scope(symbols, &scope);
+    stencil_scope.setSequential();
+
+    // Declare a register per view and load the elements of the first iteration except the leading ones
+    for (const vector<bh_view> &group: stencil_groups) {
+        for (const bh_view &view: group) {
+            stencil_scope.insertScalarReplaced(view);
+            util::spaces(out, indent);
+            stencil_scope.writeDeclaration(view, writeType(view.base->dtype()), out);
+            out << "\n";
+        }
+    }
+    util::spaces(out, indent);
+    out << "{ // Load the registers of the first iteration\n";
+    util::spaces(out, indent + 4);
+    out << "const " << writeType(bh_type::UINT64) << " i" << loop.rank << " = 0;\n";
+    for (const vector<bh_view> &group: stencil_groups) {
+        for (size_t i = 0; i + 1 < group.size(); ++i) {
+            util::spaces(out, indent + 4);
+            out << stencil_scope.getName(group[i]) << " = a" << symbols.baseID(group[i].base);
+            write_array_subscription(stencil_scope, group[i], out);
+            out << ";\n";
+        }
+    }
+    util::spaces(out, indent);
+    out << "}\n";
+
+    // Write the loop, which loads the leading element of each group and rotates the registers after the body
+    util::spaces(out, indent);
+    loopHeadWriter(symbols, stencil_scope, loop, thread_stack, out);
+    for (const vector<bh_view> &group: stencil_groups) {
+        util::spaces(out, indent + 4);
+        out << stencil_scope.getName(group.back()) << " = a" << symbols.baseID(group.back().base);
+        write_array_subscription(stencil_scope, group.back(), out);
+        out << "; // Leading element of the stencil\n";
+    }
+    writeBlock(symbols, &stencil_scope, loop, thread_stack, false, out);
+    for (const vector<bh_view> &group: stencil_groups) {
+        util::spaces(out, indent + 4);
+        for (size_t i = 0; i + 1 < group.size(); ++i) {
+            out << stencil_scope.getName(group[i]) << " = " << stencil_scope.getName(group[i + 1]) << "; ";
+        }
+        out << "// Rotate the registers\n";
+    }
+    util::spaces(out, indent);
+    out << "}\n";
+}
+
+void Engine::writeAccumulatorLoop(const SymbolTable &symbols,
+                                  const Scope &scope,
+                                  const LoopB &loop,
+                                  const vector<InstrPtr> &reductions,
+                                  int num_accumulators,
+                                  const vector<uint64_t> &thread_stack,
+                                  stringstream &out) {
+    const int indent = 4 + loop.rank * 4;
+    const int64_t unrolled_size = loop.size - loop.size % num_accumulators;
+    const string itername = "i" + std::to_string(loop.rank);
+
+    // The first accumulator is the scalar-replaced output itself, which the parent block initiates
+    util::spaces(out, indent);
+    out << "{ // " << num_accumulators << " partial accumulators per reduction\n";
+    for (int i = 1; i < num_accumulators; ++i) {
+        Scope acc_scope(symbols, &scope);
+        for (const InstrPtr &instr: reductions) {
+            const bh_view &view = instr->operand[0];
+            acc_scope.setAccumulator(view, i);
+            util::spaces(out, indent + 4);
+            out << writeType(view.base->dtype()) << " " << acc_scope.getName(view) << " = ";
+            sweep_identity(instr->opcode, view.base->dtype()).pprint(out, false);
+            out << ";\n";
+        }
+    }
+
+    // Write the unrolled loop where the i'th copy of the body updates the i'th partial accumulators
+    util::spaces(out, indent + 4);
+    out << "for(uint64_t " << itername << "_unrolled = 0; " << itername << "_unrolled < " << unrolled_size << "; ";
+    out << itername << "_unrolled += " << num_accumulators << ") {\n";
+    for (int i = 0; i < num_accumulators; ++i) {
+        Scope acc_scope(symbols, &scope);
+        for (const InstrPtr &instr: reductions) {
+            acc_scope.setAccumulator(instr->operand[0], i);
+        }
+        util::spaces(out, indent + 8);
+        out << "{\n";
+        util::spaces(out, indent + 12);
+        out << "const " << writeType(bh_type::UINT64) << " " << itername << " = " << itername << "_unrolled + " << i
+            << ";\n";
+        writeBlock(symbols, &acc_scope, loop, thread_stack, false, out);
+        util::spaces(out, indent + 8);
+        out << "}\n";
+    }
+    util::spaces(out, indent + 4);
+    out << "}\n";
+
+    // Write the remaining iterations, which updates the first accumulators
+    if (unrolled_size < loop.size) {
+        util::spaces(out, indent + 4);
+        out << "for(uint64_t " << itername << " = " << unrolled_size << "; " << itername << " < " << loop.size << "; ++"
+            << itername << ") {\n";
+        writeBlock(symbols, &scope, loop, thread_stack, false, out);
+        util::spaces(out, indent + 4);
+        out << "}\n";
+    }
+
+    // Finally, we combine the partial accumulators and write the result back to the original array
+    for (const InstrPtr &instr: reductions) {
+        const bh_view &view = instr->operand[0];
+        for (int i = 1; i < num_accumulators; ++i) {
+            Scope acc_scope(symbols, &scope);
+            acc_scope.setAccumulator(view, i);
+            util::spaces(out, indent + 4);
+            write_operation(*instr, {scope.getName(view), acc_scope.getName(view)}, out, false);
+        }
+        util::spaces(out, indent + 4);
+        out << "a" << symbols.baseID(view.base);
+        write_array_subscription(scope, view, out, false, instr->sweep_axis());
+        out << " = " << scope.getName(view) << ";\n";
+    }
+    util::spaces(out, indent);
+    out << "}\n";
+}
+
 void Engine::writeInstr(Scope &scope, const bh_instruction &instr, int indent, bool opencl, stringstream &out) {
     // We build the list of operands that goes into the `write_operation()` call
     vector<string> ops;
@@ -301,8 +755,17 @@ void Engine::writeInstr(Scope &scope, const bh_instruction &instr, int indent, b
         ops.push_back(get_name_and_subscription(scope, instr.operand[0]));
         // Write the previous element access, NB: this works because of loop peeling
         stringstream ss;
+        if (scope.isScanCarry(instr.operand[0].base)) {
+            // The first element of a chunk of a parallel scan continues from the carry of the previous chunks
+            ss << "(i" << instr.sweep_axis() << " == i" << instr.sweep_axis() << "_begin ? ";
+            scope.getName(instr.operand[0], ss);
+            ss << "_carry : ";
+        }
         scope.getName(instr.operand[0], ss);
         write_array_subscription(scope, instr.operand[0], ss, true, BH_MAXDIM, make_pair(instr.sweep_axis(), -1));
+        if (scope.isScanCarry(instr.operand[0].base)) {
+            ss << ")";
+        }
         ops.push_back(ss.str());
         // Write the current element access
         ops.push_back(get_name_and_subscription(scope, instr.operand[1]));
@@ -19,6 +19,7 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #include <vector>
 #include <set>
+#include <memory>
 
 #include <jitk/engines/engine_cpu.hpp>
 
@@ -40,13 +41,6 @@ void EngineCPU::handleExecution(BhIR *bhir) {
 
     const auto texecution = chrono::steady_clock::now();
 
-    map<string, bool> kernel_config = {
-            {"strides_as_var", comp.config.defaultGet<bool>("strides_as_var", true)},
-            {"index_as_var",   comp.config.defaultGet<bool>("index_as_var", true)},
-            {"const_as_var",   comp.config.defaultGet<bool>("const_as_var", true)},
-            {"use_volatile",   comp.config.defaultGet<bool>("volatile", false)}
-    };
-
     // Some statistics
     stat.record(*bhir);
 
@@ -59,6 +53,53 @@ void EngineCPU::handleExecution(BhIR *bhir) {
         bh_data_free(base);
     }
 
+    // Let's reuse the memory of arrays that die at an elementwise instruction for the output of the instruction
+    if (comp.config.defaultGet<bool>("inplace_rewrite", true)) {
+        rewrite_inplace(instr_list);
+    }
+
+    if (autotuner.enabled()) {
+        // Let's execute the instruction list using the variant selected by the autotuner, which times it
+        const uint64_t instr_list_hash = FuseCache::hash(instr_list);
+        const Autotuner::Variant &variant = autotuner.select(instr_list_hash);
+        const auto tvariant = chrono::steady_clock::now();
+        comp.config.setOverrides(variant.options);
+        fcache.setVariant(variant.hash);
+        codegen_cache.setVariant(variant.hash);
+        executeInstrList(instr_list, variant.hash);
+        comp.config.setOverrides({});
+        const chrono::duration<double> tvariant_total = chrono::steady_clock::now() - tvariant;
+        autotuner.record(instr_list_hash, variant, tvariant_total.count());
+    } else {
+        executeInstrList(instr_list, 0);
+    }
+    stat.time_total_execution += chrono::steady_clock::now() - texecution;
+}
+
+void EngineCPU::executeInstrList(vector<bh_instruction *> &instr_list, uint64_t variant_hash) {
+
+    map<string, bool> kernel_config = {
+            {"strides_as_var", comp.config.defaultGet<bool>("strides_as_var", true)},
+            {"index_as_var",   comp.config.defaultGet<bool>("index_as_var", true)},
+            {"const_as_var",   comp.config.defaultGet<bool>("const_as_var", true)},
+            {"use_volatile",   comp.config.defaultGet<bool>("volatile", false)},
+            {"stencil_reuse",  comp.config.defaultGet<bool>("stencil_register_reuse", false)}
+    };
+
+    // Let's check the plan cache, which skips fusion, codegen, and compilation of repeated flushes
+    PlanCache::Key plan_key;
+    const bool plan_cacheable = use_plan_cache and PlanCache::createKey(instr_list, kernel_config["const_as_var"],
+                                                                        plan_key);
+    if (plan_cacheable) {
+        plan_key.hash ^= variant_hash;
+        vector<KernelPlan> *plan = plan_cache.lookup(plan_key);
+        if (plan != nullptr) {
+            executePlan(*plan, plan_key, instr_list);
+            return;
+        }
+    }
+    vector<KernelPlan> plan;
+
     // Set the constructor flag
     if (comp.config.defaultGet<bool>("array_contraction", true)) {
         setConstructorFlag(instr_list);
@@ -72,56 +113,129 @@ void EngineCPU::handleExecution(BhIR *bhir) {
     vector<LoopB> kernel_list = get_kernel_list(instr_list, comp.config, fcache, stat, false,
                                                 comp.config.defaultGet<bool>("monolithic", true));
 
+    // Let's create the symbol tables and the source code of all kernels up front, which makes it possible
+    // to compile the kernels in parallel (see `prepareFunctions()`) before executing them in order
+    vector<unique_ptr<SymbolTable> > symbol_list;
+    vector<pair<string, uint64_t> > source_list; // The empty string when the kernel does no computation
+    symbol_list.reserve(kernel_list.size());
+    source_list.reserve(kernel_list.size());
     for (const LoopB &kernel: kernel_list) {
         // Let's create the symbol table for the kernel
-        const SymbolTable symbols(kernel,
-                                  kernel_config["use_volatile"],
-                                  kernel_config["strides_as_var"],
-                                  kernel_config["index_as_var"],
-                                  kernel_config["const_as_var"]
-        );
-
+        symbol_list.emplace_back(new SymbolTable(kernel,
+                                                 kernel_config["use_volatile"],
+                                                 kernel_config["strides_as_var"],
+                                                 kernel_config["index_as_var"],
+                                                 kernel_config["const_as_var"],
+                                                 kernel_config["stencil_reuse"]
+        ));
+        const SymbolTable &symbols = *symbol_list.back();
         stat.record(symbols);
 
-        if (not kernel.isSystemOnly()) { // We can skip this step if the kernel does no computation
+        if (kernel.isSystemOnly()) { // We can skip this step if the kernel does no computation
+            source_list.emplace_back();
+            continue;
+        }
+        const auto lookup = codegen_cache.lookup(kernel, symbols);
+        if (not lookup.first.empty()) {
+            // In debug mode, we check that the cached source code is correct
+            #ifndef NDEBUG
+                stringstream ss;
+                writeKernel(kernel, symbols, {}, lookup.second, ss);
+                if (ss.str().compare(lookup.first) != 0) {
+                    cout << "\nCached source code: \n" << lookup.first;
+                    cout << "\nReal source code: \n" << ss.str();
+                    assert(1 == 2);
+                }
+            #endif
+            source_list.push_back(lookup);
+        } else {
+            const auto tcodegen = chrono::steady_clock::now();
+            stringstream ss;
+            writeKernel(kernel, symbols, {}, lookup.second, ss);
+            string source = ss.str();
+            stat.time_codegen += chrono::steady_clock::now() - tcodegen;
+
+            codegen_cache.insert(source, kernel, symbols);
+            source_list.emplace_back(std::move(source), lookup.second);
+        }
+    }
+    prepareFunctions(source_list);
+
+    for (size_t i = 0; i < kernel_list.size(); ++i) {
+        const LoopB &kernel = kernel_list[i];
+        const SymbolTable &symbols = *symbol_list[i];
+        const string &source = source_list[i].first;
+
+        KernelFunction func = nullptr;
+        uint64_t source_hash = 0;
+        string source_filename;
+        if (not kernel.isSystemOnly()) {
             // Create the constant vector
             vector<const bh_instruction *> constants;
             constants.reserve(symbols.constIDs().size());
             for (const InstrPtr &instr: symbols.constIDs()) {
                 constants.push_back(&(*instr));
             }
+            func = execute(symbols, source, source_list[i].second, constants);
+            source_hash = util::hash(source);
+            source_filename = hash_filename(compilation_hash, source_hash, ".c");
+        }
+        if (plan_cacheable) {
+            plan.push_back(PlanCache::createKernelPlan(plan_key, kernel, symbols, func, source_hash,
+                                                     std::move(source_filename)));
+        }
 
-            const auto lookup = codegen_cache.lookup(kernel, symbols);
-            if (not lookup.first.empty()) {
-                // In debug mode, we check that the cached source code is correct
-                #ifndef NDEBUG
-                    stringstream ss;
-                    writeKernel(kernel, symbols, {}, lookup.second, ss);
-                    if (ss.str().compare(lookup.first) != 0) {
-                        cout << "\nCached source code: \n" << lookup.first;
-                        cout << "\nReal source code: \n" << ss.str();
-                        assert(1 == 2);
-                    }
-                #endif
-                execute(symbols, lookup.first, lookup.second, constants);
-            } else {
-                const auto tcodegen = chrono::steady_clock::now();
-                stringstream ss;
-                writeKernel(kernel, symbols, {}, lookup.second, ss);
-                string source = ss.str();
-                stat.time_codegen += chrono::steady_clock::now() - tcodegen;
+        // Finally, let's cleanup
+        for (bh_base *base: kernel.getAllFrees()) {
+            bh_data_free(base);
+        }
+    }
+    if (plan_cacheable) {
+        plan_cache.insert(plan_key, std::move(plan));
+    }
+}
+
+void EngineCPU::executePlan(vector<KernelPlan> &plan, const PlanCache::Key &key,
+                            const vector<bh_instruction *> &instr_list) {
+    vector<void *> data_list;
+    for (KernelPlan &kernel: plan) {
+        stat.num_base_arrays += kernel.num_base_arrays;
+        stat.num_temp_arrays += kernel.num_temp_arrays;
 
-                execute(symbols, source, lookup.second, constants);
-                codegen_cache.insert(std::move(source), kernel, symbols);
+        if (kernel.func != nullptr) {
+            // Make sure all arrays are allocated and create the 'data_list' of data pointers
+            data_list.clear();
+            for (size_t base_id: kernel.params) {
+                bh_base *base = key.bases[base_id];
+                bh_data_malloc(base);
+                assert(base->getDataPtr() != nullptr);
+                data_list.push_back(base->getDataPtr());
             }
+            data_list.push_back(scratch_arena.interface());
+
+            // The offset-and-strides are part of the plan key thus only the constants needs updating
+            for (size_t i = 0; i < kernel.constants.size(); ++i) {
+                if (kernel.constant_origins[i] >= 0) {
+                    kernel.constants[i] = instr_list[kernel.constant_origins[i]]->constant.value;
+                }
+            }
+
+            auto start_exec = chrono::steady_clock::now();
+            // Call the launcher function, which will execute the kernel
+            kernel.func(data_list.data(), kernel.offset_and_strides.data(), kernel.constants.data());
+            scratch_arena.reset();
+            auto texec = chrono::steady_clock::now() - start_exec;
+            stat.time_exec += texec;
+            KernelStats &kernel_stats = stat.time_per_kernel[kernel.source_filename];
+            kernel_stats.register_exec_time(texec);
+            kernel.func = updateFunction(kernel.source_hash, kernel_stats, kernel.func);
         }
 
         // Finally, let's cleanup
-        for (bh_base *base: kernel.getAllFrees()) {
-            bh_data_free(base);
+        for (size_t base_id: kernel.frees) {
+            bh_data_free(key.bases[base_id]);
         }
     }
-    stat.time_total_execution += chrono::steady_clock::now() - texecution;
 }
 
 void EngineCPU::handleExtmethod(BhIR *bhir){
@@ -370,27 +370,36 @@ void fuser_reshapable_first(vector<Block> &block_list, bool avoid_rank0_sweep) {
     block_list = ret;
 }
 
-void fuser_greedy(const ConfigParser &config, vector<Block> &block_list, bool avoid_rank0_sweep) {
+namespace {
+// Fuses 'block_list' greedily using 'cost_model'
+void fuser_greedy(const FusionCostModel &cost_model, int64_t greedy_threshold, vector<Block> &block_list,
+                  bool avoid_rank0_sweep) {
 
     graph::DAG dag = graph::from_block_list(block_list);
 
-    size_t greedy_threshold = config.defaultGet<size_t>("greedy_threshold", 10000);
-    if (boost::num_edges(dag) > greedy_threshold) {
+    if (greedy_threshold >= 0 and boost::num_edges(dag) > static_cast<uint64_t>(greedy_threshold)) {
         fuser_reshapable_first(block_list, avoid_rank0_sweep);
         return;
     }
 
-    graph::greedy(dag, avoid_rank0_sweep);
+    graph::greedy(dag, avoid_rank0_sweep, cost_model);
     vector<Block> ret = graph::fill_block_list(dag);
 
     // Let's fuse at the next rank level
     for (Block &b: ret) {
         if (not b.isInstr()) {
-            fuser_greedy(config, b.getLoop()._block_list, avoid_rank0_sweep);
+            fuser_greedy(cost_model, greedy_threshold, b.getLoop()._block_list, avoid_rank0_sweep);
         }
     }
     block_list = ret;
 }
+}
+
+void fuser_greedy(const ConfigParser &config, vector<Block> &block_list, bool avoid_rank0_sweep) {
+    const auto cost_model = create_cost_model(config);
+    const int64_t greedy_threshold = config.defaultGet<int64_t>("greedy_threshold", 10000);
+    fuser_greedy(*cost_model, greedy_threshold, block_list, avoid_rank0_sweep);
+}
 
 } // jitk
 } // bohrium
@@ -20,8 +20,15 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <vector>
 #include <iostream>
+#include <fstream>
+#include <boost/filesystem/operations.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/serialization/string.hpp>
 
+#include <bh_version.h>
 #include <jitk/fuser_cache.hpp>
+#include <jitk/codegen_util.hpp>
 
 
 using namespace std;
@@ -177,10 +184,112 @@ std::vector<bh_base*> calc_base_ids(const vector<bh_instruction *> &instr_list)
     }
     return ret;
 }
+
+// The version of the persistent cache format, which must be incremented when the format changes
+constexpr uint32_t FILE_VERSION = 2;
+
+// The bases of a loaded block list are placeholders of the base IDs. The placeholders are only used to map
+// cached bases to new bases thus they are never dereferenced (see `FuseCache::get()`)
+bh_base *base_placeholder(size_t base_id) {
+    return reinterpret_cast<bh_base *>(base_id + 1);
+}
+
+// Is every base in `block` found in `base2id`?
+bool has_base_ids(const Block &block, const map<const bh_base *, size_t> &base2id) {
+    if (block.isInstr()) {
+        for (const bh_view &view: block.getInstr()->getViews()) {
+            if (not util::exist(base2id, view.base)) {
+                return false;
+            }
+        }
+        return true;
+    }
+    for (const bh_base *base: block.getLoop()._frees) {
+        if (not util::exist(base2id, base)) {
+            return false;
+        }
+    }
+    for (const Block &b: block.getLoop()._block_list) {
+        if (not has_base_ids(b, base2id)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Write `block` to `ar` where bases are written as their base ID (see `has_base_ids()`)
+template<typename Archive>
+void save_block(Archive &ar, const Block &block, const map<const bh_base *, size_t> &base2id) {
+    const bool is_instr = block.isInstr();
+    const int rank = block.rank();
+    ar << is_instr;
+    ar << rank;
+    if (is_instr) {
+        bh_instruction instr(*block.getInstr());
+        for (bh_view &view: instr.getViews()) {
+            view.base = base_placeholder(base2id.at(view.base));
+        }
+        ar << instr;
+        ar << instr.constructor;
+        ar << instr.origin_id;
+    } else {
+        const LoopB &loop = block.getLoop();
+        ar << loop.size;
+        vector<uint64_t> frees;
+        for (const bh_base *base: loop._frees) {
+            frees.push_back(base2id.at(base));
+        }
+        ar << frees;
+        const uint64_t num_blocks = loop._block_list.size();
+        ar << num_blocks;
+        for (const Block &b: loop._block_list) {
+            save_block(ar, b, base2id);
+        }
+    }
+}
+
+// Read a block written by `save_block()`
+template<typename Archive>
+Block load_block(Archive &ar) {
+    bool is_instr;
+    int rank;
+    ar >> is_instr;
+    ar >> rank;
+    if (is_instr) {
+        bh_instruction instr;
+        ar >> instr;
+        ar >> instr.constructor;
+        ar >> instr.origin_id;
+        return Block(instr, rank);
+    }
+    int64_t size;
+    ar >> size;
+    LoopB loop(rank, size);
+    vector<uint64_t> frees;
+    ar >> frees;
+    for (uint64_t base_id: frees) {
+        loop._frees.insert(base_placeholder(base_id));
+    }
+    uint64_t num_blocks;
+    ar >> num_blocks;
+    loop._block_list.reserve(num_blocks);
+    for (uint64_t i = 0; i < num_blocks; ++i) {
+        loop._block_list.push_back(load_block(ar));
+    }
+    loop.metadataUpdate();
+    return Block(std::move(loop));
+}
 } // Anon namespace
 
+size_t FuseCache::hash(const vector<bh_instruction *> &instr_list) {
+    return hash_instr_list(instr_list);
+}
+
 pair<vector<Block>, bool> FuseCache::get(const vector<bh_instruction *> &instr_list) {
-    const size_t lookup_hash = hash_instr_list(instr_list);
+    if (not _loaded) {
+        load();
+    }
+    const size_t lookup_hash = hash_instr_list(instr_list) ^ _variant;
     ++stat.fuser_cache_lookups;
 
     if (_cache.find(lookup_hash) != _cache.end()) { // Cache hit!
@@ -214,9 +323,91 @@ pair<vector<Block>, bool> FuseCache::get(const vector<bh_instruction *> &instr_l
 }
 
 void FuseCache::insert(const vector<bh_instruction *> &instr_list, vector<Block> block_list) {
-    const size_t lookup_hash = hash_instr_list(instr_list);
+    const size_t lookup_hash = hash_instr_list(instr_list) ^ _variant;
     CachePayload payload = {std::move(block_list), calc_base_ids(instr_list)};
     _cache.insert(make_pair(lookup_hash, std::move(payload)));
+    _dirty = true;
+}
+
+void FuseCache::load() {
+    _loaded = true;
+    if (_file.empty() or not boost::filesystem::exists(_file)) {
+        return;
+    }
+    try {
+        ifstream ifs(_file.string(), ios::binary);
+        boost::archive::binary_iarchive ia(ifs);
+        uint32_t version;
+        ia >> version;
+        string bh_version;
+        ia >> bh_version;
+        if (version != FILE_VERSION or bh_version != BH_VERSION_STRING) {
+            return; // Written by another version of Bohrium, which might fuse or generate code differently
+        }
+        uint64_t num_entries;
+        ia >> num_entries;
+        for (uint64_t i = 0; i < num_entries; ++i) {
+            uint64_t lookup_hash, num_bases, num_blocks;
+            ia >> lookup_hash;
+            ia >> num_bases;
+            ia >> num_blocks;
+            CachePayload payload;
+            for (uint64_t j = 0; j < num_bases; ++j) {
+                payload.base_ids.push_back(base_placeholder(j));
+            }
+            for (uint64_t j = 0; j < num_blocks; ++j) {
+                payload.block_list.push_back(load_block(ia));
+            }
+            // NB: entries already in the cache take precedence
+            _cache.insert(make_pair(static_cast<size_t>(lookup_hash), std::move(payload)));
+        }
+    } catch (const std::exception &e) {
+        cout << "Warning: ignoring the fuser cache " << _file << ". " << e.what() << endl;
+    }
+}
+
+void FuseCache::save() {
+    if (_file.empty() or not _dirty) {
+        return;
+    }
+    load(); // Let's include the entries other processes have written since we loaded the file
+    stringstream ss;
+    {
+        boost::archive::binary_oarchive oa(ss);
+        oa << FILE_VERSION;
+        oa << string(BH_VERSION_STRING);
+        // Entries with bases outside their base IDs cannot be written thus we skip them
+        vector<pair<uint64_t, map<const bh_base *, size_t> > > entries;
+        for (const auto &entry: _cache) {
+            const CachePayload &payload = entry.second;
+            map<const bh_base *, size_t> base2id;
+            for (size_t i = 0; i < payload.base_ids.size(); ++i) {
+                base2id.insert(make_pair(payload.base_ids[i], i));
+            }
+            bool valid = true;
+            for (const Block &block: payload.block_list) {
+                valid = valid and has_base_ids(block, base2id);
+            }
+            if (valid) {
+                entries.emplace_back(entry.first, std::move(base2id));
+            }
+        }
+        const uint64_t num_entries = entries.size();
+        oa << num_entries;
+        for (const auto &entry: entries) {
+            const CachePayload &payload = _cache.at(entry.first);
+            const uint64_t lookup_hash = entry.first, num_bases = payload.base_ids.size();
+            const uint64_t num_blocks = payload.block_list.size();
+            oa << lookup_hash;
+            oa << num_bases;
+            oa << num_blocks;
+            for (const Block &block: payload.block_list) {
+                save_block(oa, block, entry.second);
+            }
+        }
+    }
+    write_file_atomically(ss.str(), _file);
+    _dirty = false;
 }
 
 } // jitk
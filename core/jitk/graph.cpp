@@ -20,13 +20,14 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/breadth_first_search.hpp>
 #include <boost/graph/graphviz.hpp>
 #include <boost/graph/topological_sort.hpp>
 #include <boost/foreach.hpp>
 #include <fstream>
+#include <algorithm>
 #include <numeric>
 #include <queue>
+#include <memory>
 #include <cassert>
 
 #include <jitk/graph.hpp>
@@ -39,49 +40,164 @@ namespace bohrium {
 namespace jitk {
 namespace graph {
 
-/* Determines whether there exist a path from 'a' to 'b'
- *
- * Complexity: O(E + V)
+namespace {
+
+/* A topological order of the vertices in a DAG, which is maintained incrementally when edges are added using the
+ * dynamic topological sort algorithm by Pearce and Kelly. The order makes it possible to prune path searches:
+ * a path from 'a' to 'b' can only visit vertices positioned between 'a' and 'b'.
  *
- * @a               The first vertex
- * @b               The second vertex
- * @dag             The DAG
- * @only_long_path  Only accept path of length greater than one
- * @return          True if there is a path
+ * NB: cleared vertices (i.e. vertices without edges) are simply left in the order
  */
-bool path_exist(Vertex a, Vertex b, const DAG &dag, bool only_long_path) {
-    using namespace boost;
+class TopologicalOrder {
+private:
+    const DAG &_dag;
+    // The position of each vertex in the order
+    vector<uint64_t> _ord;
+    // The visit stamp of each vertex, which saves us from clearing a visited set between searches
+    vector<uint64_t> _visited;
+    uint64_t _stamp = 0;
+
+    // Collect the vertices reachable from 'v' positioned before 'max_ord' (incl. 'v') in 'out'
+    void forward(Vertex v, uint64_t max_ord, vector<Vertex> &out) {
+        vector<Vertex> stack = {v};
+        _visited[v] = _stamp;
+        while (not stack.empty()) {
+            const Vertex u = stack.back();
+            stack.pop_back();
+            out.push_back(u);
+            BOOST_FOREACH(Vertex child, boost::adjacent_vertices(u, _dag)) {
+                assert(_ord[child] != max_ord); // A cycle!
+                if (_visited[child] != _stamp and _ord[child] < max_ord) {
+                    _visited[child] = _stamp;
+                    stack.push_back(child);
+                }
+            }
+        }
+    }
 
-    struct path_visitor:default_bfs_visitor {
-        const Vertex dst;
-        path_visitor(Vertex b):dst(b){};
+    // Collect the vertices that reach 'v' positioned after 'min_ord' (incl. 'v') in 'out'
+    void backward(Vertex v, uint64_t min_ord, vector<Vertex> &out) {
+        vector<Vertex> stack = {v};
+        _visited[v] = _stamp;
+        while (not stack.empty()) {
+            const Vertex u = stack.back();
+            stack.pop_back();
+            out.push_back(u);
+            BOOST_FOREACH(Vertex parent, boost::inv_adjacent_vertices(u, _dag)) {
+                if (_visited[parent] != _stamp and _ord[parent] > min_ord) {
+                    _visited[parent] = _stamp;
+                    stack.push_back(parent);
+                }
+            }
+        }
+    }
 
-        void examine_edge(Edge e, const DAG &g) const {
-            if(target(e,g) == dst)
-                throw runtime_error("");
+public:
+    explicit TopologicalOrder(const DAG &dag) : _dag(dag), _ord(boost::num_vertices(dag)),
+                                                _visited(boost::num_vertices(dag), 0) {
+        vector<Vertex> topological_order;
+        boost::topological_sort(dag, back_inserter(topological_order));
+        // NB: `topological_sort()` returns the vertices in reverse order
+        uint64_t i = topological_order.size();
+        for (Vertex v: topological_order) {
+            _ord[v] = --i;
         }
-    };
-    struct long_visitor:default_bfs_visitor {
-        const Vertex src, dst;
-        long_visitor(Vertex a, Vertex b):src(a),dst(b){};
+    }
+
+    /* Determines whether there exist a path from 'a' to 'b' of length greater than one
+     *
+     * Complexity: O(E + V) of the sub-graph positioned between 'a' and 'b'
+     */
+    bool longPathExist(Vertex a, Vertex b) {
+        const uint64_t max_ord = _ord[b];
+        ++_stamp;
+        vector<Vertex> stack;
+        BOOST_FOREACH(Vertex child, boost::adjacent_vertices(a, _dag)) {
+            if (child != b and _ord[child] < max_ord) {
+                _visited[child] = _stamp;
+                stack.push_back(child);
+            }
+        }
+        while (not stack.empty()) {
+            const Vertex u = stack.back();
+            stack.pop_back();
+            BOOST_FOREACH(Vertex child, boost::adjacent_vertices(u, _dag)) {
+                if (child == b) {
+                    return true;
+                }
+                if (_visited[child] != _stamp and _ord[child] < max_ord) {
+                    _visited[child] = _stamp;
+                    stack.push_back(child);
+                }
+            }
+        }
+        return false;
+    }
 
-        void examine_edge(Edge e, const DAG &g) const
-        {
-            if(source(e,g) != src and target(e,g) == dst)
-                throw runtime_error("");
+    /* Update the order after the edge 'a->b' has been added to the DAG
+     *
+     * Complexity: O(E + V) of the sub-graph positioned between 'b' and 'a'
+     */
+    void addEdge(Vertex a, Vertex b) {
+        const uint64_t lower = _ord[b], upper = _ord[a];
+        if (upper < lower) {
+            return; // The order is still valid
+        }
+        // The vertices reachable from 'b' must be moved after the vertices that reach 'a'
+        vector<Vertex> reach_from_b, reach_a;
+        ++_stamp;
+        forward(b, upper, reach_from_b);
+        ++_stamp;
+        backward(a, lower, reach_a);
+        const auto by_ord = [this](Vertex v1, Vertex v2) { return _ord[v1] < _ord[v2]; };
+        sort(reach_from_b.begin(), reach_from_b.end(), by_ord);
+        sort(reach_a.begin(), reach_a.end(), by_ord);
+
+        // Let's re-use the positions of the moved vertices
+        vector<uint64_t> positions;
+        positions.reserve(reach_from_b.size() + reach_a.size());
+        for (Vertex v: reach_a) {
+            positions.push_back(_ord[v]);
+        }
+        for (Vertex v: reach_from_b) {
+            positions.push_back(_ord[v]);
+        }
+        sort(positions.begin(), positions.end());
+        size_t i = 0;
+        for (Vertex v: reach_a) {
+            _ord[v] = positions[i++];
+        }
+        for (Vertex v: reach_from_b) {
+            _ord[v] = positions[i++];
         }
-    };
-    try {
-        if(only_long_path)
-            breadth_first_search(dag, a, visitor(long_visitor(a,b)));
-        else
-            breadth_first_search(dag, a, visitor(path_visitor(b)));
     }
-    catch (const runtime_error &e) {
+
+    // Check that the order is valid (for debugging)
+    bool validate() const {
+        BOOST_FOREACH(Edge e, boost::edges(_dag)) {
+            if (_ord[boost::source(e, _dag)] >= _ord[boost::target(e, _dag)]) {
+                return false;
+            }
+        }
         return true;
     }
-    return false;
+};
+
+// Remove the vertices in 'dag' that are not 'alive'
+void remove_dead_vertices(DAG &dag, const vector<bool> &alive) {
+    DAG ret;
+    vector<Vertex> old2new(boost::num_vertices(dag));
+    BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+        if (alive[v]) {
+            old2new[v] = boost::add_vertex(std::move(dag[v]), ret);
+        }
+    }
+    BOOST_FOREACH(Edge e, boost::edges(dag)) {
+        boost::add_edge(old2new[boost::source(e, dag)], old2new[boost::target(e, dag)], ret);
+    }
+    dag = std::move(ret);
 }
+} // Anon namespace
 
 // Create a DAG based on the 'block_list'
 DAG from_block_list(const vector<Block> &block_list) {
@@ -200,10 +316,12 @@ void merge_vertices(DAG &dag, Vertex a, Vertex b, const bool remove_b) {
 }
 
 void transitive_reduction(DAG &dag) {
+    TopologicalOrder order(dag);
     vector<Edge> removals;
     BOOST_FOREACH(Edge e, boost::edges(dag)) {
-        if(path_exist(source(e,dag), target(e,dag), dag, true))
+        if (order.longPathExist(source(e, dag), target(e, dag))) {
             removals.push_back(e);
+        }
     }
     for (Edge &e: removals) {
         remove_edge(e, dag);
@@ -316,51 +434,98 @@ void pprint(const DAG &dag, const char *filename, bool avoid_rank0_sweep, int id
     file.close();
 }
 
-void greedy(DAG &dag, bool avoid_rank0_sweep) {
-    while(1) {
-        // First we find all fusible edges
-        vector<Edge> fusibles;
-        {
-            auto edges = boost::edges(dag);
-            for (auto it = edges.first; it != edges.second;) {
-                Edge e = *it; ++it; // NB: we iterate here because boost::remove_edge() invalidates 'it'
-                Vertex v1 = source(e, dag);
-                Vertex v2 = target(e, dag);
-                // Remove transitive edges
-                if(path_exist(v1, v2, dag, true)) {
-                    boost::remove_edge(e, dag);
-                } else {
-                    const Block &b1 = dag[v1];
-                    const Block &b2 = dag[v2];
-                    if (mergeable(b1, b2, avoid_rank0_sweep)) {
-                        fusibles.push_back(e);
-                    }
-                }
+void greedy(DAG &dag, bool avoid_rank0_sweep, const FusionCostModel &cost_model) {
+    // A candidate edge to merge over. The candidate is stale when one of the vertices has changed since the
+    // candidate was created, which we detect using the version of the vertices.
+    struct Candidate {
+        double weight;
+        Vertex src, dst;
+        uint64_t src_version, dst_version;
+
+        // The greatest weight comes first and ties are broken by the vertex IDs, which makes the fusion deterministic
+        bool operator<(const Candidate &other) const {
+            if (weight != other.weight) {
+                return weight < other.weight;
+            }
+            if (src != other.src) {
+                return src > other.src;
             }
+            return dst > other.dst;
         }
-        // Any more vertices to fuse?
-        if (fusibles.size() == 0) {
-            break;
+    };
+    const uint64_t num_vertices = boost::num_vertices(dag);
+    TopologicalOrder order(dag);
+    vector<uint64_t> version(num_vertices, 0);
+    vector<bool> alive(num_vertices, true);
+    priority_queue<Candidate> candidates;
+
+    // The profile of each vertex, which the cost model use to calculate the weight of an edge.
+    // Notice, instruction blocks are never merged thus they have no profile.
+    vector<unique_ptr<BlockProfile> > profiles(num_vertices);
+    BOOST_FOREACH(Vertex v, boost::vertices(dag)) {
+        if (not dag[v].isInstr()) {
+            profiles[v].reset(new BlockProfile(dag[v].getLoop()));
         }
+    }
 
-        // Let's find the greatest weight edge.
-        Edge greatest = fusibles.front();
-        uint64_t greatest_weight = weight(dag[source(greatest, dag)], dag[target(greatest, dag)]);
-        for (Edge e: fusibles) {
-            const uint64_t w = weight(dag[source(e, dag)], dag[target(e, dag)]);
-            if (w > greatest_weight) {
-                greatest = e;
-                greatest_weight = w;
-            }
+    // Push the edge 'v1->v2' to 'candidates' unless the cost model finds that the merge slows down execution
+    // NB: we postpone the `mergeable()` check until the candidate is popped since most candidates become stale
+    const auto push_candidate = [&](Vertex v1, Vertex v2) {
+        if (dag[v1].isInstr() or dag[v2].isInstr()) {
+            return; // Instruction blocks cannot be fused
         }
-        Vertex v1 = source(greatest, dag);
-        Vertex v2 = target(greatest, dag);
-//        cout << "merge: " << v1 << ", " << v2 << endl;
+        const double benefit = cost_model.benefit(*profiles[v1], *profiles[v2]);
+        if (benefit >= 0) {
+            candidates.push(Candidate{benefit, v1, v2, version[v1], version[v2]});
+        }
+    };
+    BOOST_FOREACH(Edge e, boost::edges(dag)) {
+        push_candidate(source(e, dag), target(e, dag));
+    }
+
+    // Each iteration merges over the greatest weight edge that isn't transitive
+    while (not candidates.empty()) {
+        const Candidate c = candidates.top();
+        candidates.pop();
+        if (c.src_version != version[c.src] or c.dst_version != version[c.dst]) {
+            continue; // Stale candidate
+        }
+        const auto edge = boost::edge(c.src, c.dst, dag);
+        if (not edge.second or not mergeable(dag[c.src], dag[c.dst], avoid_rank0_sweep)) {
+            continue;
+        }
+        // Merging over a transitive edge would introduce a cycle thus we remove it
+        if (order.longPathExist(c.src, c.dst)) {
+            boost::remove_edge(edge.first, dag);
+            continue;
+        }
+        merge_vertices(dag, c.src, c.dst, false);
+        alive[c.dst] = false;
+        ++version[c.src];
+        ++version[c.dst];
+        // The profile of the merged vertex is the union of the two profiles. We merge the smaller profile into
+        // the larger one, which keeps a long chain of merges from copying the growing profile over and over.
+        if (profiles[c.src]->bases.size() < profiles[c.dst]->bases.size()) {
+            swap(profiles[c.src], profiles[c.dst]);
+        }
+        profiles[c.src]->merge(*profiles[c.dst]);
+        profiles[c.dst].reset();
 
-        assert(not path_exist(v1, v2, dag, true)); // Transitive edges should have been removed by now
+        // The parents of 'dst' are now parents of 'src', which might break the topological order
+        BOOST_FOREACH(Vertex parent, boost::inv_adjacent_vertices(c.src, dag)) {
+            order.addEdge(parent, c.src);
+        }
+        assert(order.validate());
 
-        merge_vertices(dag, v1, v2, true);
+        // Finally, the edges of the merged vertex are new candidates
+        BOOST_FOREACH(Vertex parent, boost::inv_adjacent_vertices(c.src, dag)) {
+            push_candidate(parent, c.src);
+        }
+        BOOST_FOREACH(Vertex child, boost::adjacent_vertices(c.src, dag)) {
+            push_candidate(c.src, child);
+        }
     }
+    remove_dead_vertices(dag, alive);
     assert(validate(dag));
 }
 
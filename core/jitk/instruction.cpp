@@ -19,6 +19,9 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <sstream>
+#include <map>
+#include <algorithm>
+#include <iterator>
 
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
@@ -559,10 +562,11 @@ bh_constant sweep_identity(bh_opcode opcode, bh_type dtype) {
             return bh_constant(1, dtype);
         case BH_BITWISE_AND_REDUCE:
         case BH_LOGICAL_AND_REDUCE:
-            return bh_constant(~0u, dtype);
+            // All bits set in the full width of `dtype`
+            return bh_constant(int64_t{-1}, dtype);
         case BH_MAXIMUM_REDUCE:
             if (dtype == bh_type::BOOL) {
-                return bh_constant(bh_bool{1});
+                return bh_constant(bh_bool{0});
             } else {
                 return bh_constant::get_min(dtype);
             }
@@ -594,6 +598,96 @@ vector<bh_instruction *> remove_non_computed_system_instr(vector <bh_instruction
     return ret;
 }
 
+namespace {
+// Return true when `instr` only accesses the element of each array at the index it writes, thus its output can
+// overwrite an input of the same view
+bool elementwise_inplace(const bh_instruction &instr) {
+    if (instr.opcode == BH_RANGE or instr.opcode == BH_RANDOM) {
+        return true;
+    }
+    return bh_opcode_is_elementwise(instr.opcode) and not bh_opcode_is_system(instr.opcode);
+}
+
+// Return true when `view` accesses all of its base array in row-major order
+bool whole_base(const bh_view &view) {
+    return not view.isConstant() and not view.hasSlide() and view.start == 0 and view.isContiguous() and
+           view.shape.prod() == view.base->nelem();
+}
+}
+
+uint64_t rewrite_inplace(vector<bh_instruction *> &instr_list) {
+    // The instructions that access each base array in order
+    map<const bh_base *, vector<size_t> > accesses;
+    for (size_t i = 0; i < instr_list.size(); ++i) {
+        for (const bh_base *base: iterator::allBases(*instr_list[i])) {
+            vector<size_t> &list = accesses[base];
+            if (list.empty() or list.back() != i) {
+                list.push_back(i);
+            }
+        }
+    }
+
+    uint64_t count = 0;
+    for (size_t f = 0; f < instr_list.size(); ++f) {
+        if (instr_list[f]->opcode != BH_FREE) {
+            continue;
+        }
+        bh_base *dead = instr_list[f]->operand[0].base;
+        vector<size_t> &dead_accesses = accesses[dead];
+        if (dead_accesses.size() < 2 or dead_accesses.back() != f) {
+            continue;
+        }
+        // The instruction that reads the dead array last, which must create its output array
+        const size_t last = dead_accesses[dead_accesses.size() - 2];
+        const bh_instruction &instr = *instr_list[last];
+        if (instr.operand.empty() or not elementwise_inplace(instr) or not whole_base(instr.operand[0])) {
+            continue;
+        }
+        bh_base *born = instr.operand[0].base;
+        if (born == dead or born->dtype() != dead->dtype() or born->nelem() != dead->nelem() or
+            born->getDataPtr() != nullptr or accesses[born].front() != last) {
+            continue;
+        }
+        // Every access of the dead array must be an elementwise access of the whole array, which makes sure that
+        // no instruction reads an element that a fused instruction has overwritten already
+        bool compatible = true;
+        for (size_t i = 0; i + 1 < dead_accesses.size() and compatible; ++i) {
+            const bh_instruction &other = *instr_list[dead_accesses[i]];
+            compatible = elementwise_inplace(other);
+            for (const bh_view &view: other.operand) {
+                if (view.base == dead and not whole_base(view)) {
+                    compatible = false;
+                }
+            }
+        }
+        if (not compatible) {
+            continue;
+        }
+
+        // Let's write the output array in place of the dead array, which leaves only the free of the dead array
+        for (size_t i = 0; i + 1 < dead_accesses.size(); ++i) {
+            for (bh_view &view: instr_list[dead_accesses[i]]->operand) {
+                if (view.base == dead) {
+                    view.base = born;
+                }
+            }
+        }
+        if (dead->getDataPtr() != nullptr) {
+            born->resetDataPtr(dead->getDataPtr());
+            dead->resetDataPtr();
+        }
+        vector<size_t> &born_accesses = accesses[born];
+        vector<size_t> merged;
+        std::merge(dead_accesses.begin(), dead_accesses.end() - 1, born_accesses.begin(), born_accesses.end(),
+                   std::back_inserter(merged));
+        merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+        born_accesses = std::move(merged);
+        dead_accesses = {f};
+        ++count;
+    }
+    return count;
+}
+
 InstrPtr reshape_rank(const InstrPtr &instr, int rank, int64_t size_of_rank_dim) {
     vector <int64_t> shape((size_t) rank + 1);
     // The dimensions up til 'rank' (not including 'rank') are unchanged
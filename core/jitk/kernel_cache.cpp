@@ -0,0 +1,235 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <map>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#include <jitk/kernel_cache.hpp>
+
+using namespace std;
+namespace fs = boost::filesystem;
+
+namespace bohrium {
+namespace jitk {
+
+KernelCache::Lock::Lock(const fs::path &path, bool exclusive, bool remove_on_release, bool wait) :
+        _remove_on_release(remove_on_release ? path : fs::path()) {
+    while (true) {
+        _fd = ::open(path.string().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0666);
+        if (_fd < 0) {
+            throw runtime_error("KernelCache: cannot open lock file " + path.string());
+        }
+        while (::flock(_fd, (exclusive ? LOCK_EX : LOCK_SH) | (wait ? 0 : LOCK_NB)) != 0) {
+            if (not wait and errno == EWOULDBLOCK) {
+                ::close(_fd);
+                _fd = -1;
+                return;
+            }
+            if (errno != EINTR) {
+                ::close(_fd);
+                throw runtime_error("KernelCache: cannot lock " + path.string());
+            }
+        }
+        if (not remove_on_release) {
+            return;
+        }
+        // The previous holder might have removed the lock file while we were waiting,
+        // in which case we locked an orphan and have to try again
+        struct stat fd_stat, path_stat;
+        if (::fstat(_fd, &fd_stat) == 0 and ::stat(path.string().c_str(), &path_stat) == 0 and
+            fd_stat.st_dev == path_stat.st_dev and fd_stat.st_ino == path_stat.st_ino) {
+            return;
+        }
+        ::close(_fd);
+    }
+}
+
+KernelCache::Lock::~Lock() {
+    if (not locked()) {
+        return;
+    }
+    // NB: we remove the lock file before unlocking, which makes the waiters try again (see above)
+    if (not _remove_on_release.empty()) {
+        ::unlink(_remove_on_release.string().c_str());
+    }
+    ::flock(_fd, LOCK_UN);
+    ::close(_fd);
+}
+
+namespace {
+// Return a filename that is unique across threads and processes
+string unique_suffix() {
+    stringstream ss;
+    ss << "." << ::getpid() << "." << std::hash<std::thread::id>()(std::this_thread::get_id()) << ".tmp";
+    return ss.str();
+}
+}
+
+KernelCache::KernelCache(fs::path dir, int64_t max_files, const string &name, set<string> extensions) :
+        _dir(std::move(dir)),
+        _index_dir(_dir.empty() ? fs::path() : _dir / (name + "_index")),
+        _max_files(max_files),
+        _extensions(std::move(extensions)) {
+    if (enabled()) {
+        fs::create_directories(_index_dir);
+    }
+}
+
+bool KernelCache::contains(const string &filename) const {
+    return enabled() and fs::exists(_dir / filename);
+}
+
+fs::path KernelCache::lookup(const string &filename) const {
+    if (not contains(filename)) {
+        return fs::path();
+    }
+    touch(filename);
+    return _dir / filename;
+}
+
+void KernelCache::publish(const fs::path &file, const string &filename) const {
+    if (not enabled()) {
+        return;
+    }
+    try {
+        // We copy into the cache dir first since `rename()` is only atomic within a filesystem
+        const fs::path tmp = _index_dir / (filename + unique_suffix());
+        fs::copy_file(file, tmp, fs::copy_option::overwrite_if_exists);
+        fs::rename(tmp, _dir / filename);
+    } catch (const fs::filesystem_error &e) {
+        cout << "Warning: couldn't write JIT kernel to the cache dir " << _dir << ". " << e.what() << endl;
+        return;
+    }
+    touch(filename);
+}
+
+unique_ptr<KernelCache::Lock> KernelCache::lockCompilation(const string &filename) const {
+    if (not enabled()) {
+        return nullptr;
+    }
+    return unique_ptr<Lock>(new Lock(lockFile(filename), true, true));
+}
+
+void KernelCache::touch(const string &filename) const {
+    if (_max_files < 0) { // No eviction thus no need for an index
+        return;
+    }
+    const string line = filename + "\n";
+    const fs::path index = _index_dir / "index";
+    struct stat st;
+    {
+        // Appenders share the index lock whereas `compact()` takes it exclusively
+        Lock lock(_index_dir / "index.lock", false, false);
+        const int fd = ::open(index.string().c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0666);
+        if (fd < 0) {
+            return; // A missing index entry only makes the eviction less accurate
+        }
+        const ssize_t written = ::write(fd, line.c_str(), line.size());
+        const int ret = ::fstat(fd, &st);
+        ::close(fd);
+        if (written != static_cast<ssize_t>(line.size()) or ret != 0) {
+            return;
+        }
+    }
+    // We compact when the index has twice as many entries as the cache should hold
+    const uint64_t max_index_size = 2 * static_cast<uint64_t>(_max_files) * line.size();
+    if (static_cast<uint64_t>(st.st_size) > max_index_size) {
+        compact(max_index_size);
+    }
+}
+
+void KernelCache::compact(uint64_t max_index_size) const {
+    const fs::path index = _index_dir / "index";
+    Lock lock(_index_dir / "index.lock", true, false);
+    if (fs::file_size(index) <= max_index_size) { // Another process got here first
+        return;
+    }
+
+    // Find the last use of each kernel, kernels not in the index are considered the least recently used
+    map<string, uint64_t> last_use;
+    for (fs::directory_iterator it(_dir), end; it != end; ++it) {
+        if (fs::is_regular_file(it->status()) and _extensions.find(it->path().extension().string()) != _extensions.end()) {
+            last_use[it->path().filename().string()] = 0;
+        }
+    }
+    uint64_t count = 0;
+    {
+        ifstream in(index.string());
+        string filename;
+        while (getline(in, filename)) {
+            auto it = last_use.find(filename);
+            if (it != last_use.end()) {
+                it->second = ++count;
+            }
+        }
+    }
+    // Kernels younger than the index are the exception. They were published after the last index entry was
+    // written thus their publisher is about to touch them.
+    const time_t index_time = fs::last_write_time(index);
+    for (auto &kernel: last_use) {
+        boost::system::error_code ec;
+        if (kernel.second == 0 and fs::last_write_time(_dir / kernel.first, ec) >= index_time and not ec) {
+            kernel.second = count + 1;
+        }
+    }
+    vector<pair<uint64_t, string> > lru_order;
+    lru_order.reserve(last_use.size());
+    for (const auto &kernel: last_use) {
+        lru_order.emplace_back(kernel.second, kernel.first);
+    }
+    sort(lru_order.begin(), lru_order.end());
+
+    // Evict the least recently used kernels and write the new index
+    const size_t num_evict = lru_order.size() > static_cast<size_t>(_max_files) ?
+                             lru_order.size() - static_cast<size_t>(_max_files) : 0;
+    const fs::path tmp = _index_dir / ("index" + unique_suffix());
+    {
+        ofstream out(tmp.string());
+        for (size_t i = 0; i < lru_order.size(); ++i) {
+            if (i < num_evict) {
+                // A process that is compiling or publishing the kernel holds its lock thus we keep the kernel
+                Lock kernel_lock(lockFile(lru_order[i].second), true, true, false);
+                if (kernel_lock.locked()) {
+                    boost::system::error_code ec;
+                    fs::remove(_dir / lru_order[i].second, ec);
+                } else {
+                    out << lru_order[i].second << "\n";
+                }
+            } else {
+                out << lru_order[i].second << "\n";
+            }
+        }
+    }
+    fs::rename(tmp, index);
+}
+
+} // jitk
+} // bohrium
@@ -0,0 +1,143 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <vector>
+#include <iostream>
+
+#include <jitk/plan_cache.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+/* The plan hash consists of the following fields:
+ * [<opcode>[<base_id><dtype><start>[<shape><stride>...]|<constant dtype>[<constant>]...]<sweep_axis()>...]
+ * Notice, in contrast to the fuse cache hash, every field that might end up in the kernel source is included.
+ */
+bool PlanCache::createKey(const vector<bh_instruction *> &instr_list, bool const_as_var, Key &key) {
+    stringstream ss;
+    for (const bh_instruction *instr: instr_list) {
+        ss << "op" << instr->opcode;
+        for (const bh_view &view: instr->operand) {
+            if (view.isConstant()) {
+                ss << "c" << static_cast<uint32_t>(instr->constant.type);
+                if (not const_as_var) {
+                    ss << ":" << instr->constant;
+                }
+            } else {
+                // The start of sliding views changes between iterations, which the plan cannot handle
+                if (view.hasSlide()) {
+                    return false;
+                }
+                auto it = key.base_ids.find(view.base);
+                size_t base_id;
+                if (it == key.base_ids.end()) {
+                    base_id = key.bases.size();
+                    key.base_ids.insert(make_pair(view.base, base_id));
+                    key.bases.push_back(view.base);
+                } else {
+                    base_id = it->second;
+                }
+                ss << "b" << base_id << "t" << static_cast<uint32_t>(view.base->dtype()) << "s" << view.start;
+                for (int64_t j = 0; j < view.ndim; ++j) {
+                    ss << "," << view.shape[j] << ":" << view.stride[j];
+                }
+            }
+        }
+        ss << "a" << instr->sweep_axis() << ";";
+    }
+    key.hash = util::hash(ss.str());
+    key.num_instrs = instr_list.size();
+    return true;
+}
+
+KernelPlan PlanCache::createKernelPlan(const Key &key, const LoopB &kernel, const SymbolTable &symbols,
+                                       KernelFunction func, uint64_t source_hash, std::string source_filename) {
+    KernelPlan ret;
+    ret.func = func;
+    ret.source_hash = source_hash;
+    ret.source_filename = std::move(source_filename);
+    ret.num_base_arrays = symbols.getNumBaseArrays();
+    ret.num_temp_arrays = symbols.getNumBaseArrays() - symbols.getParams().size();
+
+    ret.params.reserve(symbols.getParams().size());
+    for (const bh_base *base: symbols.getParams()) {
+        ret.params.push_back(key.base_ids.at(base));
+    }
+
+    for (const bh_view *view: symbols.offsetStrideViews()) {
+        ret.offset_and_strides.push_back(static_cast<uint64_t>(view->start));
+        for (int64_t i = 0; i < view->ndim; ++i) {
+            ret.offset_and_strides.push_back(static_cast<uint64_t>(view->stride[i]));
+        }
+    }
+
+    // Constants of instructions in the instruction list are read on every execution whereas constants of
+    // instructions injected by the code generator (e.g. identity instructions) are fixed.
+    // NB: sweeped axis values are never updated (see `update_with_origin()` in the fuse cache)
+    for (const InstrPtr &instr: symbols.constIDs()) {
+        ret.constants.push_back(instr->constant.value);
+        if (instr->origin_id >= 0 and static_cast<size_t>(instr->origin_id) < key.num_instrs
+            and not bh_opcode_is_sweep(instr->opcode)) {
+            ret.constant_origins.push_back(instr->origin_id);
+        } else {
+            ret.constant_origins.push_back(-1);
+        }
+    }
+
+    for (const bh_base *base: kernel.getAllFrees()) {
+        ret.frees.push_back(key.base_ids.at(base));
+    }
+    return ret;
+}
+
+std::vector<KernelPlan> *PlanCache::lookup(const Key &key) {
+    ++stat.plan_cache_lookups;
+    auto it = _cache.find(key.hash);
+    if (it != _cache.end()) { // Cache hit!
+        _lru.splice(_lru.begin(), _lru, it->second.second);
+        return &it->second.first;
+    } else {
+        ++stat.plan_cache_misses;
+        return nullptr;
+    }
+}
+
+void PlanCache::insert(const Key &key, std::vector<KernelPlan> plan) {
+    auto it = _cache.find(key.hash);
+    if (it != _cache.end()) {
+        it->second.first = std::move(plan);
+        _lru.splice(_lru.begin(), _lru, it->second.second);
+        return;
+    }
+    if (_max_plans == 0) {
+        return;
+    }
+    if (_max_plans > 0 and _cache.size() >= static_cast<size_t>(_max_plans)) {
+        _cache.erase(_lru.back());
+        _lru.pop_back();
+    }
+    _lru.push_front(key.hash);
+    _cache.insert(make_pair(key.hash, make_pair(std::move(plan), _lru.begin())));
+}
+
+} // jitk
+} // bohrium
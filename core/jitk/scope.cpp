@@ -38,5 +38,16 @@ Scope::writeIdxDeclaration(const bh_view &view, const std::string &type_str, int
     _declared_idx.insert(view);
 }
 
+void Scope::writePartialIdxDeclaration(const bh_view &view, const std::string &type_str, int rank,
+                                       std::stringstream &out) {
+    assert(partialIdxRank(view) < rank);
+    out << "const " << type_str << " ";
+    getPartialIdxName(view, rank, out);
+    out << " = (";
+    write_partial_array_index(*this, view, rank, out);
+    out << ");";
+    _partial_idx[view] = rank;
+}
+
 } // jitk
 } // bohrium
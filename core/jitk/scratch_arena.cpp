@@ -0,0 +1,109 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <jitk/scratch_arena.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+namespace {
+// The alignment of scratch allocations, which keeps the partial results of different threads in separate cache lines
+constexpr uint64_t alignment = 64;
+
+uint64_t align_up(uint64_t nbytes) {
+    return (nbytes + alignment - 1) / alignment * alignment;
+}
+
+void *aligned_malloc(uint64_t nbytes) {
+    void *ret = nullptr;
+    if (posix_memalign(&ret, alignment, nbytes) != 0) {
+        throw std::bad_alloc();
+    }
+    return ret;
+}
+}
+
+ScratchArena::ScratchArena(uint64_t limit) : _limit(limit) {
+    _interface.arena = this;
+    _interface.alloc = [](void *arena, uint64_t nbytes) {
+        return static_cast<ScratchArena *>(arena)->alloc(nbytes);
+    };
+    _interface.free = [](void *arena, void *mem) {
+        static_cast<ScratchArena *>(arena)->free(mem);
+    };
+}
+
+ScratchArena::~ScratchArena() {
+    reset();
+    std::free(_mem);
+}
+
+void *ScratchArena::alloc(uint64_t nbytes) {
+    nbytes = align_up(std::max(nbytes, uint64_t{1}));
+    _used += nbytes;
+    _peak = std::max(_peak, _used);
+    // Once a call overflows, the rest of its allocations overflow as well, which keeps the LIFO order
+    if (_overflow.empty() and _top + nbytes <= _size) {
+        void *ret = _mem + _top;
+        _top += nbytes;
+        return ret;
+    }
+    void *ret = aligned_malloc(nbytes);
+    _overflow.emplace_back(ret, nbytes);
+    return ret;
+}
+
+void ScratchArena::free(void *mem) {
+    if (not _overflow.empty()) {
+        assert(_overflow.back().first == mem);
+        _used -= _overflow.back().second;
+        std::free(_overflow.back().first);
+        _overflow.pop_back();
+        return;
+    }
+    char *m = static_cast<char *>(mem);
+    assert(_mem <= m and m < _mem + _top);
+    _used -= _top - static_cast<uint64_t>(m - _mem);
+    _top = static_cast<uint64_t>(m - _mem);
+}
+
+void ScratchArena::reset() {
+    for (const auto &mem: _overflow) {
+        std::free(mem.first);
+    }
+    _overflow.clear();
+    _top = 0;
+    _used = 0;
+    if (_peak > _size and _peak <= _limit) {
+        std::free(_mem);
+        _mem = static_cast<char *>(aligned_malloc(_peak));
+        _size = _peak;
+    }
+    _peak = 0;
+}
+
+}
+} // namespace
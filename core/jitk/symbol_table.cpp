@@ -32,11 +32,13 @@ SymbolTable::SymbolTable(const LoopB &kernel,
                          bool use_volatile,
                          bool strides_as_var,
                          bool index_as_var,
-                         bool const_as_var) : _useRandom(false),
-                                              use_volatile(use_volatile),
-                                              strides_as_var(strides_as_var),
-                                              index_as_var(index_as_var),
-                                              const_as_var(const_as_var) {
+                         bool const_as_var,
+                         bool stencil_reuse) : _useRandom(false),
+                                               use_volatile(use_volatile),
+                                               strides_as_var(strides_as_var),
+                                               index_as_var(index_as_var),
+                                               const_as_var(const_as_var),
+                                               stencil_reuse(stencil_reuse) {
 
     // NB: by assigning the IDs in the order they appear in the 'instr_list',
     //     the kernels can better be reused
@@ -18,8 +18,14 @@ GNU Lesser General Public License along with Bohrium.
 If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cmath>
+#include <map>
+#include <limits>
+#include <algorithm>
+
 #include <jitk/transformer.hpp>
 #include <jitk/iterator.hpp>
+#include <bh_util.hpp>
 
 using namespace std;
 
@@ -140,6 +146,315 @@ bool collapse_loop_with_child(LoopB &loop) {
     }
     return false;
 }
+
+// The smallest tile size along an axis, which keeps the innermost loops long enough to vectorize
+constexpr int64_t MIN_TILE_SIZE = 8;
+
+// Help function that returns the instructions of 'loop' when it is a perfect loop nest i.e. all instructions are
+// in the innermost loop and all the other loops have a single sub-block
+bool perfect_nest(const LoopB &loop, vector<InstrPtr> &instr_list) {
+    const LoopB *innermost = &loop;
+    while (innermost->_block_list.size() == 1 and not innermost->_block_list[0].isInstr()) {
+        innermost = &innermost->_block_list[0].getLoop();
+    }
+    for (const Block &b: innermost->_block_list) {
+        if (not b.isInstr()) {
+            return false;
+        }
+        const InstrPtr &instr = b.getInstr();
+        if (bh_opcode_is_system(instr->opcode) or instr->ndim() != innermost->rank + 1) {
+            return false;
+        }
+        instr_list.push_back(instr);
+    }
+    return not instr_list.empty();
+}
+
+// Help function that returns the instructions of 'loop' when it is a perfect loop nest of elementwise instructions.
+// Iterations of such a nest are independent thus the nest can be traversed in any order.
+bool perfect_elementwise_nest(const LoopB &loop, vector<InstrPtr> &instr_list) {
+    if (not perfect_nest(loop, instr_list)) {
+        return false;
+    }
+    for (const InstrPtr &instr: instr_list) {
+        if (bh_opcode_is_sweep(instr->opcode) or instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER
+            or instr->opcode == BH_COND_SCATTER or not instr->all_same_shape()) {
+            return false;
+        }
+        for (const bh_view &view: instr->getViews()) {
+            if (view.hasSlide()) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Help function that finds the loop order of the perfect loop nest of 'instr_list' that traverses the arrays with
+// the smallest strides innermost where 'temps' are the temporary arrays of the nest. Each axis is weighted by the
+// bytes it strides over in all accessed arrays, the swept axes keeps their position, and axes of equal weight keep
+// their order. Returns the new order as a list of the original axes.
+vector<int64_t> find_loop_order(const vector<InstrPtr> &instr_list, const set<bh_base *> &temps) {
+    const int64_t ndim = instr_list[0]->ndim();
+    vector<double> weights(static_cast<size_t>(ndim), 0);
+    vector<bool> swept(static_cast<size_t>(ndim), false);
+    for (const InstrPtr &instr: instr_list) {
+        const int64_t sa = instr->sweep_axis();
+        if (sa < ndim) {
+            swept[sa] = true;
+        }
+        for (size_t o = 0; o < instr->operand.size(); ++o) {
+            const bh_view &view = instr->operand[o];
+            // NB: the input of gather and the output of scatter has arbitrary shape and stride
+            if (view.isConstant() or temps.find(view.base) != temps.end() or (o == 1 and instr->opcode == BH_GATHER)
+                or (o == 0 and (instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER))) {
+                continue;
+            }
+            const double elem_size = bh_type_size(view.base->dtype());
+            for (int64_t i = 0; i < ndim; ++i) {
+                // The output of a reduction doesn't have the swept axis
+                int64_t view_axis = i;
+                if (o == 0 and bh_opcode_is_reduction(instr->opcode)) {
+                    if (i == sa) {
+                        continue;
+                    }
+                    view_axis = i > sa ? i - 1 : i;
+                }
+                weights[i] += std::abs(view.stride[view_axis]) * elem_size;
+            }
+        }
+    }
+    // Axes of length one should never end up innermost
+    const BhIntVec shape = instr_list[0]->shape();
+    vector<int64_t> movable;
+    for (int64_t i = 0; i < ndim; ++i) {
+        if (shape[i] == 1) {
+            weights[i] = std::numeric_limits<double>::infinity();
+        }
+        if (not swept[i]) {
+            movable.push_back(i);
+        }
+    }
+    vector<int64_t> sorted(movable);
+    std::stable_sort(sorted.begin(), sorted.end(), [&weights](int64_t a, int64_t b) {
+        return weights[a] > weights[b];
+    });
+    vector<int64_t> ret;
+    for (int64_t i = 0, j = 0; i < ndim; ++i) {
+        ret.push_back(swept[i] ? i : sorted[j++]);
+    }
+    return ret;
+}
+
+// Help function that returns the largest divisor of 'n' that is less than or equal to 'limit'
+int64_t largest_divisor(int64_t n, int64_t limit) {
+    for (int64_t d = std::min(n, limit); d > 1; --d) {
+        if (n % d == 0) {
+            return d;
+        }
+    }
+    return 1;
+}
+
+// Help function that finds the tile size of each axis of the loop nest of 'instr_list' (zero means untiled)
+// where 'temps' are the temporary arrays of the nest. Returns the empty vector when tiling doesn't make sense.
+vector<int64_t> find_tiles(const vector<InstrPtr> &instr_list, const set<bh_base *> &temps, uint64_t cache_size,
+                           uint64_t min_tiles) {
+    const BhIntVec shape = instr_list[0]->shape();
+    const int64_t ndim = static_cast<int64_t>(shape.size());
+    if (ndim < 2 or ndim * 2 > BH_MAXDIM) {
+        return {};
+    }
+
+    // Let's find whether iterations reuse data: a base accessed through multiple views (e.g. a stencil) is reused
+    // along the outer axes and a view that isn't traversed with the smallest stride innermost (e.g. a transposed
+    // view) reuses cache lines along the outer axes. Temporary arrays never reach memory thus we ignore them.
+    set<bh_view> views;
+    map<const bh_base *, int64_t> num_views;
+    bool transposed = false;
+    for (const InstrPtr &instr: instr_list) {
+        for (const bh_view &view: instr->getViews()) {
+            if (temps.find(view.base) != temps.end() or not views.insert(view).second) {
+                continue;
+            }
+            ++num_views[view.base];
+            int64_t min_axis = -1;
+            for (int64_t i = 0; i < ndim; ++i) {
+                if (view.shape[i] > 1 and view.stride[i] != 0 and
+                    (min_axis == -1 or std::abs(view.stride[i]) < std::abs(view.stride[min_axis]))) {
+                    min_axis = i;
+                }
+            }
+            transposed |= min_axis != -1 and min_axis != ndim - 1;
+        }
+    }
+    // The bytes per element of the reused bases, which must stay in cache between slabs (the previous, current, and
+    // next slab of stencils), and the bytes per element of the bases that are streamed through the cache
+    uint64_t reused_bytes = 0, streamed_bytes = 0;
+    for (const auto &base_views: num_views) {
+        const uint64_t elem_size = static_cast<uint64_t>(bh_type_size(base_views.first->dtype()));
+        if (base_views.second > 1) {
+            reused_bytes += elem_size * 3;
+        } else {
+            streamed_bytes += elem_size;
+        }
+    }
+    const uint64_t bytes = reused_bytes + streamed_bytes;
+    if (bytes == 0 or not (reused_bytes > 0 or transposed)) {
+        return {};
+    }
+
+    // A transposed view needs square tiles of the two innermost axes whereas a stencil only needs to tile the
+    // innermost axes that makes the slab reused by the next outer iteration exceed the cache.
+    int64_t num_tiled = 0;
+    if (transposed) {
+        num_tiled = 2;
+    } else {
+        uint64_t working_set = reused_bytes;
+        for (int64_t k = 1; k < ndim; ++k) {
+            working_set *= static_cast<uint64_t>(shape[ndim - k]);
+            if (working_set > cache_size) {
+                num_tiled = k;
+                break;
+            }
+        }
+    }
+    if (num_tiled == 0) {
+        return {};
+    }
+
+    // The tiles of the 'num_tiled' innermost axes should fit the cache and have (roughly) the same size
+    const double elems_per_tile = std::max(static_cast<double>(cache_size) / bytes, 1.0);
+    const int64_t edge = static_cast<int64_t>(std::pow(elems_per_tile, 1.0 / num_tiled));
+    vector<int64_t> tiles(static_cast<size_t>(ndim), 0);
+    bool tiled = false;
+    for (int64_t i = ndim - num_tiled; i < ndim; ++i) {
+        const int64_t t = largest_divisor(shape[i], edge);
+        // NB: a strip-mined axis must divide evenly and a poor divisor would make the tiles too small
+        if (t < shape[i] and t >= MIN_TILE_SIZE and t * 2 > edge) {
+            tiles[i] = t;
+            tiled = true;
+        }
+    }
+    if (not tiled) {
+        return {};
+    }
+
+    // Let's make sure that the tiles can be distributed between threads by shrinking the outermost tiles
+    for (int64_t i = ndim - num_tiled; i < ndim; ++i) {
+        while (tiles[i] > 0) {
+            uint64_t num_tiles = 1;
+            for (int64_t j = 0; j < ndim; ++j) {
+                if (tiles[j] > 0) {
+                    num_tiles *= static_cast<uint64_t>(shape[j] / tiles[j]);
+                }
+            }
+            const int64_t t = largest_divisor(shape[i], tiles[i] - 1);
+            if (num_tiles >= min_tiles or t < MIN_TILE_SIZE) {
+                break;
+            }
+            tiles[i] = t;
+        }
+    }
+    return tiles;
+}
+
+// Help function that strip-mines the axes of 'view' that have a tile size in 'tiles'. The new axes that traverse
+// the tiles become the outermost axes and the original axes traverse the elements within a tile.
+void tile_view(bh_view &view, const vector<int64_t> &tiles) {
+    assert(view.ndim == static_cast<int64_t>(tiles.size()));
+    BhIntVec shape, stride;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (tiles[i] > 0) {
+            assert(view.shape[i] % tiles[i] == 0);
+            shape.push_back(view.shape[i] / tiles[i]);
+            stride.push_back(view.stride[i] * tiles[i]);
+        }
+    }
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        shape.push_back(tiles[i] > 0 ? tiles[i] : view.shape[i]);
+        stride.push_back(view.stride[i]);
+    }
+    view.ndim = static_cast<int64_t>(shape.size());
+    view.shape = std::move(shape);
+    view.stride = std::move(stride);
+}
+
+// Is 'instr' of the loop 'loop' invariant to the loop? That is, all inputs are broadcasted along the axis of 'loop'
+// (stride zero) or are scalar-replaced temporary arrays and none of them are written within 'loop'. The output
+// must be a temporary array that only 'instr' writes. 'nwrites' is the number of instructions in 'loop' that write
+// each base array.
+bool loop_invariant(const LoopB &loop, const bh_instruction &instr, const set<bh_base *> &temps,
+                    const map<const bh_base *, int> &nwrites) {
+    if (instr.operand.empty() or bh_opcode_is_system(instr.opcode) or instr.sweep_axis() != BH_MAXDIM or
+        instr.opcode == BH_GATHER or instr.opcode == BH_SCATTER or instr.opcode == BH_COND_SCATTER or
+        instr.opcode == BH_RANGE or instr.opcode == BH_RANDOM) {
+        return false;
+    }
+    const bh_view &out = instr.operand[0];
+    if (not(instr.constructor and util::exist(temps, out.base) and nwrites.at(out.base) == 1)) {
+        return false;
+    }
+    for (size_t i = 1; i < instr.operand.size(); ++i) {
+        const bh_view &view = instr.operand[i];
+        if (view.isConstant()) {
+            continue;
+        }
+        if (util::exist(nwrites, view.base) and nwrites.at(view.base) > 0) {
+            return false;
+        }
+        if (not(util::exist(temps, view.base) or (view.ndim > loop.rank and view.stride[loop.rank] == 0))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hoists the loop-invariant instructions of the loops nested within 'loop' in front of the loops and returns the
+// instructions of 'loop' that are invariant to 'loop' itself (with the axis of 'loop' removed)
+vector<InstrPtr> hoist_invariants(LoopB &loop, const set<bh_base *> &temps) {
+    // Let's start with the nested loops, which moves their invariant instructions into this loop
+    {
+        vector<Block> block_list;
+        for (Block &b: loop._block_list) {
+            if (not b.isInstr()) {
+                for (const InstrPtr &instr: hoist_invariants(b.getLoop(), temps)) {
+                    block_list.emplace_back(*instr, loop.rank + 1);
+                }
+            }
+            block_list.push_back(std::move(b));
+        }
+        loop._block_list = std::move(block_list);
+        loop.metadataUpdate();
+    }
+    vector<InstrPtr> ret;
+    if (loop.rank < 1) { // The parent is the kernel, which has no axis to hoist into
+        return ret;
+    }
+
+    map<const bh_base *, int> nwrites;
+    for (const InstrPtr &instr: iterator::allInstr(loop)) {
+        if (not instr->operand.empty()) {
+            ++nwrites[instr->operand[0].base];
+        }
+    }
+    vector<Block> block_list;
+    for (Block &b: loop._block_list) {
+        if (b.isInstr() and b.getInstr() != nullptr and loop_invariant(loop, *b.getInstr(), temps, nwrites)) {
+            bh_instruction instr(*b.getInstr());
+            --nwrites[instr.operand[0].base];
+            instr.remove_axis(loop.rank);
+            ret.push_back(std::make_shared<bh_instruction>(instr));
+        } else {
+            block_list.push_back(std::move(b));
+        }
+    }
+    loop._block_list = std::move(block_list);
+    if (not ret.empty()) {
+        loop.metadataUpdate();
+    }
+    return ret;
+}
 }
 
 void push_reductions_inwards(vector<Block> &block_list) {
@@ -244,6 +559,75 @@ void collapse_redundant_axes(vector<Block> &block_list) {
     }
     block_list = ret;
 }
+
+void interchange_loops(vector<Block> &block_list) {
+    for (Block &block: block_list) {
+        vector<InstrPtr> instr_list;
+        if (block.isInstr() or not perfect_nest(block.getLoop(), instr_list)) {
+            continue;
+        }
+        vector<int64_t> order = find_loop_order(instr_list, block.getLoop().getAllTemps());
+        vector<int64_t> current(order.size());
+        for (size_t i = 0; i < current.size(); ++i) {
+            current[i] = i;
+        }
+        if (order == current) {
+            continue;
+        }
+        // Let's permute the axes of all instructions one transposition at a time
+        vector<bh_instruction> permuted;
+        for (const InstrPtr &instr: instr_list) {
+            permuted.push_back(*instr);
+        }
+        for (size_t i = 0; i < order.size(); ++i) {
+            const size_t j = std::find(current.begin(), current.end(), order[i]) - current.begin();
+            if (i != j) {
+                for (bh_instruction &instr: permuted) {
+                    instr.transpose(i, j);
+                }
+                std::swap(current[i], current[j]);
+            }
+        }
+        vector<InstrPtr> permuted_instr_list;
+        for (const bh_instruction &instr: permuted) {
+            permuted_instr_list.push_back(std::make_shared<bh_instruction>(instr));
+        }
+        const LoopB &loop = block.getLoop();
+        block = create_nested_block(permuted_instr_list, loop.rank, loop.getAllFrees());
+    }
+}
+
+void tile(vector<Block> &block_list, uint64_t cache_size, uint64_t min_tiles) {
+    for (Block &block: block_list) {
+        vector<InstrPtr> instr_list;
+        if (block.isInstr() or not perfect_elementwise_nest(block.getLoop(), instr_list)) {
+            continue;
+        }
+        const vector<int64_t> tiles = find_tiles(instr_list, block.getLoop().getAllTemps(), cache_size, min_tiles);
+        if (tiles.empty()) {
+            continue;
+        }
+        vector<InstrPtr> tiled_instr_list;
+        for (const InstrPtr &instr: instr_list) {
+            bh_instruction tmp(*instr);
+            for (bh_view &view: tmp.getViews()) {
+                tile_view(view, tiles);
+            }
+            tiled_instr_list.push_back(std::make_shared<bh_instruction>(tmp));
+        }
+        const LoopB &loop = block.getLoop();
+        block = create_nested_block(tiled_instr_list, loop.rank, loop.getAllFrees());
+    }
+}
+void hoist_loop_invariants(vector<Block> &block_list) {
+    for (Block &block: block_list) {
+        if (not block.isInstr()) {
+            LoopB &loop = block.getLoop();
+            const set<bh_base *> temps = loop.getAllTemps();
+            hoist_invariants(loop, temps);
+        }
+    }
+}
+
 } // jitk
 } // bohrium
-
@@ -20,7 +20,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <sstream>
 
-#include <jitk/scope.hpp>
+#include <jitk/view.hpp>
 
 
 using namespace std;
@@ -31,12 +31,17 @@ namespace jitk {
 void write_array_index(const Scope &scope, const bh_view &view, stringstream &out, bool ignore_declared_indexes,
                        int hidden_axis, const pair<int, int> axis_offset) {
 
-    // Let's check if the index is already declared as a variable
+    // Let's check if the index or a partial index is already declared as a variable
     if (not ignore_declared_indexes) {
         if (scope.isIdxDeclared(view)) {
             scope.getIdxName(view, out);
             return;
         }
+        if (hidden_axis == BH_MAXDIM and axis_offset.first == BH_MAXDIM and not view.is_scalar() and
+            scope.partialIdxRank(view) >= 0) {
+            write_partial_array_index(scope, view, view.ndim - 1, out);
+            return;
+        }
     }
 
     if (scope.symbols.strides_as_var and scope.symbols.existOffsetStridesID(view)) {
@@ -87,6 +92,39 @@ void write_array_index(const Scope &scope, const bh_view &view, stringstream &ou
     }
 }
 
+void write_partial_array_index(const Scope &scope, const bh_view &view, int last_axis, stringstream &out) {
+    const bool as_var = scope.symbols.strides_as_var and scope.symbols.existOffsetStridesID(view);
+    const int first_axis = scope.partialIdxRank(view) + 1;
+    bool empty_subscription = true;
+
+    // Let's start from the innermost declared partial index or the offset of the view
+    if (first_axis > 0) {
+        scope.getPartialIdxName(view, first_axis - 1, out);
+        empty_subscription = false;
+    } else if (as_var) {
+        out << "vo" << scope.symbols.offsetStridesID(view);
+        empty_subscription = false;
+    } else if (view.start > 0) {
+        out << view.start;
+        empty_subscription = false;
+    }
+    for (int i = first_axis; i <= last_axis and i < view.ndim; ++i) {
+        if (as_var) {
+            out << " +i" << i << "*vs" << scope.symbols.offsetStridesID(view) << "_" << i;
+            empty_subscription = false;
+        } else if (view.stride[i] != 0) {
+            out << " +i" << i;
+            if (view.stride[i] != 1) {
+                out << "*" << view.stride[i];
+            }
+            empty_subscription = false;
+        }
+    }
+    if (empty_subscription) {
+        out << "0";
+    }
+}
+
 void write_array_subscription(const Scope &scope, const bh_view &view, stringstream &out, bool ignore_declared_indexes,
                               int hidden_axis, const pair<int, int> axis_offset) {
     assert(view.base != nullptr); // Not a constant
@@ -0,0 +1,71 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <jitk/worker_pool.hpp>
+
+using namespace std;
+
+namespace bohrium {
+namespace jitk {
+
+WorkerPool::WorkerPool(size_t num_workers) :
+        _num_workers(num_workers > 0 ? num_workers : max(1u, thread::hardware_concurrency())) {}
+
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard<mutex> lock(_mutex);
+        _stop = true;
+    }
+    _cond.notify_all();
+    for (thread &worker: _workers) {
+        worker.join();
+    }
+}
+
+void WorkerPool::workerLoop() {
+    unique_lock<mutex> lock(_mutex);
+    while (true) {
+        _cond.wait(lock, [this] { return _stop or not _tasks.empty(); });
+        if (_tasks.empty()) { // We are stopping and all tasks are done
+            return;
+        }
+        function<void()> task = std::move(_tasks.front());
+        _tasks.pop_front();
+        lock.unlock();
+        task(); // NB: the packaged task stores exceptions in its future
+        lock.lock();
+    }
+}
+
+void WorkerPool::enqueue(function<void()> task) {
+    {
+        lock_guard<mutex> lock(_mutex);
+        if (_workers.empty()) {
+            for (size_t i = 0; i < _num_workers; ++i) {
+                _workers.emplace_back(&WorkerPool::workerLoop, this);
+            }
+        }
+        _tasks.push_back(std::move(task));
+    }
+    _cond.notify_one();
+}
+
+} // jit
+} // bohrium
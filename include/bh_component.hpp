@@ -127,8 +127,8 @@ public:
     // The level in the runtime stack starting a -1, which is the bridge,
     // 0 is the first component in the stack list, 1 is the second component etc.
     const int stack_level;
-    // The configure file
-    const ConfigParser config;
+    // The configure file (non-const since engines can override options temporarily, see `setOverrides()`)
+    ConfigParser config;
 
     // The interface of the child. Notice, the child might not exist i.e. `child.exist() == false`
     ComponentFace child;
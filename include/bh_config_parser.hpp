@@ -25,6 +25,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <boost/algorithm/string/replace.hpp>
 #include <string>
 #include <vector>
+#include <map>
 
 // We need to specialize lexical_cast() in order to support booleans
 // other then the standard 0/1 to true/false conversion.
@@ -99,12 +100,18 @@ private:
     std::vector<std::string> _stack_list;
     // The config data
     boost::property_tree::ptree _config;
+    // Options of the default section that take precedence over the environment and the ini file
+    std::map<std::string, std::string> _overrides;
 
-    // Return section/option first looking at the environment variable
+    // Return section/option first looking at the overrides, then the environment variable,
     // and then the ini file.
     std::string lookup(const std::string &section,
                        const std::string &option) const;
 
+    // Return section/option first looking at the environment variable and then the ini file.
+    std::string lookupIgnoringOverrides(const std::string &section,
+                                        const std::string &option) const;
+
 public:
     /** Uses 'stack_level' to find the default section to use with get()
      * and when calculating the child in getChild()
@@ -258,6 +265,24 @@ public:
      * @return Component name as given in the config file
      */
     std::string getName() const { return _default_section; };
+
+    /** Return all options within 'section' as a string, which includes the options set by environment variables.
+     * Use it to identify the configuration of a component e.g. when caching results between executions.
+     *
+     * @section  The ini section e.g. [gpu]
+     * @return   The "option=value" lines of the section
+     */
+    std::string sectionAsString(const std::string &section) const;
+
+    /** Override options of the default section, which take precedence over both environment variables and
+     * the ini file until the next call. Use it to try out another configuration temporarily.
+     * NB: the overrides are not part of `sectionAsString()`
+     *
+     * @overrides  Map of option names to values (the empty map removes all overrides)
+     */
+    void setOverrides(std::map<std::string, std::string> overrides) {
+        _overrides = std::move(overrides);
+    }
 };
 
 // Path specialization of `ConfigParser::get()`, which makes sure that relative paths are converted to absolute paths
@@ -20,11 +20,38 @@ If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <cstddef>
+#include <functional>
 #include <bh_base.hpp>
 
 /** Return the size of the physical memory on this machine */
 uint64_t bh_main_memory_total();
 
+/** The huge page backing of main memory allocations (see bh_set_main_memory_paging()) */
+enum class bh_huge_pages {
+    NONE,    // Regular pages
+    MADVISE, // Transparent huge pages through `madvise(MADV_HUGEPAGE)` of 2 MB aligned allocations
+    HUGETLB  // Pages of the reserved huge page pool through `mmap(MAP_HUGETLB)`, which falls back to regular pages
+};
+
+/** Set the paging of new main memory allocations
+ *
+ * @param huge_pages            The huge page backing of allocations of at least `huge_pages_threshold` bytes
+ * @param huge_pages_threshold  The minimum size of allocations backed by huge pages
+ * @param prefault_threads      The number of threads that pre-fault the pages of allocations of at least
+ *                              `prefault_threshold` bytes. One uses `MAP_POPULATE` and zero disables pre-faulting.
+ * @param prefault_threshold    The minimum size of pre-faulted allocations
+ */
+void bh_set_main_memory_paging(bh_huge_pages huge_pages, uint64_t huge_pages_threshold,
+                               uint64_t prefault_threads, uint64_t prefault_threshold);
+
+/** Set the function that places the pages of new main memory allocations of at least `prefault_threshold` bytes
+ * (see bh_set_main_memory_paging()) on the NUMA nodes, which replaces the pre-faulting of the allocations.
+ * The function is called with the malloc cache locked thus it must not allocate or free data memory.
+ *
+ * @param placement The function that takes an allocation and its size or an empty function to disable the placement
+ */
+void bh_set_main_memory_placement(std::function<void(void *, uint64_t)> placement);
+
 /** Allocate data memory for the given base if not already allocated.
  * For convenience, the base is allowed to be NULL.
  *
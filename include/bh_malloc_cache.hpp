@@ -19,9 +19,12 @@ If not, see <http://www.gnu.org/licenses/>.
 */
 #pragma once
 
-#include <vector>
+#include <map>
+#include <set>
+#include <limits>
 #include <sstream>
 #include <stdexcept>
+#include <unordered_map>
 #include <bh_util.hpp>
 
 namespace bohrium {
@@ -29,19 +32,29 @@ namespace bohrium {
 /** Cache of memory allocations. Instead of freeing a memory allocation immediately, this cache
  * retain the allocation for later reuse.
  * To use, simply allocate and free all memory allocations through the method `alloc()` and `free()`
+ *
+ * An allocation request reuses the smallest cached segment that fits the request with at most
+ * 1/`WASTE_RATIO` of the request wasted in the tail (best-fit). The cached segments are ordered both by size and
+ * by the time they were freed thus lookup and eviction (least recently freed first) are O(log n).
  */
 class MallocCache {
 public:
     typedef std::function<void *(uint64_t)> FuncAllocT;
     typedef std::function<void(void *, uint64_t)> FuncFreeT;
 
+    // A cached segment of `n` bytes is reused for requests of at least `n - n/(WASTE_RATIO+1)` bytes
+    static constexpr uint64_t WASTE_RATIO = 8;
+
 private:
     // A segment consist of a memory allocation and a size
     struct Segment {
         std::uint64_t nbytes;
         void *mem;
     };
-    std::vector<Segment> _segments; // Segments in the cache
+    uint64_t _segment_count = 0; // The number of segments ever inserted, which orders the segments by age
+    std::map<uint64_t, Segment> _segments; // Segments in the cache ordered by age (least recently freed first)
+    std::set<std::pair<uint64_t, uint64_t> > _segments_by_size; // The size and age of the segments in the cache
+    std::unordered_map<void *, uint64_t> _oversized; // Allocations larger than requested and their actual size
 
     // Pointers to malloc and free functions
     FuncAllocT _func_alloc;
@@ -78,39 +91,19 @@ private:
         _mem_allocated -= nbytes;
     }
 
-    /** Evict a range of memory allocations from the cache
-     *
-     * @param first Iterator pointing to the first allocation
-     * @param last Iterator pointing to the element just after the last allocation
-     * @param call_free When true, the memory allocations are also freed
-     */
-    void _evict(std::vector<Segment>::iterator first, std::vector<Segment>::iterator last, bool call_free) {
-        for (auto it = first; it != last; ++it) {
-            if (call_free) {
-                _free(it->mem, it->nbytes);
-            }
-            _cache_size -= it->nbytes;
-        }
-        _segments.erase(first, last);
-    }
-
     /** Evict a memory allocation from the cache
      *
-     * @param position Iterator pointing to the allocation
+     * @param position Iterator pointing to the allocation in `_segments`
      * @param call_free When true, the memory allocations are also freed
      */
-    void _evict(std::vector<Segment>::iterator position, bool call_free) {
-        _evict(position, std::next(position), call_free);
-    }
-
-    /** Evict a memory allocation from the cache
-     * 
-     * @param position Reverse iterator pointing to the allocation
-     * @param call_free When true, the memory allocations are also freed
-     */
-    void _evict(std::vector<Segment>::reverse_iterator position, bool call_free) {
-        // Notice, we need to iterate `position` once when converting from reverse to regular iterator
-        _evict(std::next(position).base(), call_free);
+    void _evict(std::map<uint64_t, Segment>::iterator position, bool call_free) {
+        const Segment &seg = position->second;
+        if (call_free) {
+            _free(seg.mem, seg.nbytes);
+        }
+        _cache_size -= seg.nbytes;
+        _segments_by_size.erase(std::make_pair(seg.nbytes, position->first));
+        _segments.erase(position);
     }
 
 public:
@@ -128,24 +121,23 @@ public:
     std::string pprint() {
         std::stringstream ss;
         ss << "Malloc Cache: \n";
-        for (const Segment &seg: _segments) {
-            ss << "  (" << seg.nbytes << "B, " << seg.mem << ")\n";
+        for (const auto &seg: _segments) {
+            ss << "  (" << seg.second.nbytes << "B, " << seg.second.mem << ")\n";
         }
         return ss.str();
     }
 
-    /** Shrink to size of the cache with at least `nbytes`
+    /** Shrink to size of the cache with at least `nbytes` by evicting the least recently freed allocations
      *
      * @param nbytes The minimum amount of bytes to shrink with
      * @return The actual size reduction
      */
     uint64_t shrink(uint64_t nbytes) {
         uint64_t count = 0;
-        std::vector<Segment>::iterator it;
-        for (it = _segments.begin(); it != _segments.end() and count < nbytes; ++it) {
-            count += it->nbytes;
+        while (not _segments.empty() and count < nbytes) {
+            count += _segments.begin()->second.nbytes;
+            _evict(_segments.begin(), true);
         }
-        _evict(_segments.begin(), it, true);
         return count;
     }
 
@@ -188,14 +180,21 @@ public:
             return nullptr;
         }
         ++_stat_lookups;
-        // Check for segment of size `nbytes`, which is a cache hit!
-        for (auto it = _segments.rbegin(); it != _segments.rend(); ++it) { // Search in reverse
-            if (it->nbytes == nbytes) {
-                void *ret = it->mem;
-                assert(ret != nullptr);
-                _evict(it, false);
-                return ret;
+        // Check for the smallest segment that fits `nbytes`, which is a cache hit if the wasted tail is small
+        auto it = _segments_by_size.lower_bound(std::make_pair(nbytes, uint64_t{0}));
+        if (it != _segments_by_size.end() and it->first - nbytes <= nbytes / WASTE_RATIO) {
+            // Of the segments of the same size, we reuse the most recently freed one
+            it = std::prev(_segments_by_size.upper_bound(
+                    std::make_pair(it->first, std::numeric_limits<uint64_t>::max())));
+            auto seg = _segments.find(it->second);
+            assert(seg != _segments.end());
+            void *ret = seg->second.mem;
+            assert(ret != nullptr);
+            if (seg->second.nbytes != nbytes) {
+                _oversized[ret] = seg->second.nbytes;
             }
+            _evict(seg, false);
+            return ret;
         }
         ++_stat_misses;
 
@@ -203,6 +202,7 @@ public:
         shrinkToFitLimit(nbytes);
 
         void *ret = _malloc(nbytes); // Cache miss
+        _oversized.erase(ret); // A new allocation might reuse the address of an allocation freed outside the cache
         return ret;
     }
 
@@ -212,12 +212,19 @@ public:
      * @param memory The memory allocation
      */
     void free(uint64_t nbytes, void *memory) {
+        // The memory allocation might be a reused segment larger than `nbytes`
+        auto oversized = _oversized.find(memory);
+        if (oversized != _oversized.end()) {
+            nbytes = oversized->second;
+            _oversized.erase(oversized);
+        }
         if (_mem_allocated_limit == 0) {
             _free(memory, nbytes);
         } else {
-            // Insert the segment at the end of `_segments`
-            Segment seg{nbytes, memory};
-            _segments.push_back(seg);
+            // Insert the segment as the most recently freed segment
+            const uint64_t age = _segment_count++;
+            _segments.emplace_hint(_segments.end(), age, Segment{nbytes, memory});
+            _segments_by_size.insert(std::make_pair(nbytes, age));
             _cache_size += nbytes;
         }
     }
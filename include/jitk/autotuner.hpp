@@ -0,0 +1,134 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <vector>
+#include <string>
+#include <boost/filesystem/path.hpp>
+
+#include <bh_config_parser.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+/* The autotuner tries alternative fuser and codegen configurations, called variants, on instruction lists
+ * that repeat often (hot flushes) and pins the fastest variant of each instruction list.
+ * A variant is a set of options that overrides the configuration of the engine (see
+ * `ConfigParser::setOverrides()`) thus the fuser and codegen caches must be keyed by the variant as well.
+ *
+ * Each hot instruction list is executed using every variant in turn: the first execution of a variant is a warm-up
+ * (it includes fusion, codegen, and compilation) and the following `runs` executions are timed.
+ */
+class Autotuner {
+public:
+    struct Variant {
+        // The name of the variant e.g. "monolithic=true" (the empty string is the configured baseline)
+        std::string name;
+        // The options to override
+        std::map<std::string, std::string> options;
+        // The hash of the variant, which is zero for the baseline
+        uint64_t hash = 0;
+    };
+
+private:
+    // The tuning state of an instruction list
+    struct Entry {
+        // Number of executions before the instruction list became hot
+        uint64_t executions = 0;
+        // The variant being tried and the number of times it has been executed
+        size_t current = 0;
+        uint64_t trials = 0;
+        // The fastest execution time of each variant tried so far
+        std::vector<double> best_times;
+        // The index of the pinned variant or -1 while tuning
+        int64_t pinned = -1;
+    };
+
+    // The variants where the first one is the baseline
+    std::vector<Variant> _variants;
+    // Map of instruction list hashes (see `FuseCache::hash()`) to their tuning state
+    std::map<uint64_t, Entry> _entries;
+    // Is autotuning enabled?
+    const bool _enabled;
+    // Number of executions that makes an instruction list hot
+    const uint64_t _threshold;
+    // Number of timed executions of each variant
+    const uint64_t _runs;
+    // Print the pinned variants
+    const bool _verbose;
+    // The file that persists the pinned variants between executions (the empty path disables persistence)
+    boost::filesystem::path _file;
+    // Has `_file` been loaded and has a variant been pinned since?
+    bool _loaded = false;
+    bool _dirty = false;
+
+    // Load the pinned variants in `_file` of the instruction lists that isn't pinned already
+    void load();
+
+    // Pin the fastest variant of `entry`
+    void pin(uint64_t instr_list_hash, Entry &entry);
+
+public:
+    /** The constructor reads the options `autotune`, `autotune_threshold`, `autotune_runs`, and
+     * `autotune_variants`, which is a list of the options to vary. The variant of an option
+     * flips a boolean option or replaces the fuser or cost model with an alternative.
+     *
+     * @param config  The config of the engine
+     * @param verbose Print the pinned variants
+     */
+    Autotuner(const ConfigParser &config, bool verbose);
+
+    // Is autotuning enabled?
+    bool enabled() const {
+        return _enabled;
+    }
+
+    /** Return the variant to use when executing the instruction list `instr_list_hash`
+     *
+     * @param instr_list_hash The hash of the instruction list (see `FuseCache::hash()`)
+     * @return The variant, which is the baseline until the instruction list is hot
+     */
+    const Variant &select(uint64_t instr_list_hash);
+
+    /** Record the execution time of the instruction list `instr_list_hash` using `variant`
+     *
+     * @param instr_list_hash The hash of the instruction list (see `FuseCache::hash()`)
+     * @param variant         The variant returned by `select()`
+     * @param seconds         The execution time in seconds
+     */
+    void record(uint64_t instr_list_hash, const Variant &variant, double seconds);
+
+    /** Persist the pinned variants in `file`, which is loaded on the first selection and written by `save()`.
+     * NB: `file` should identify the configuration of the engine since the variants are relative to it.
+     *
+     * @param file The file path
+     */
+    void persist(boost::filesystem::path file) {
+        _file = std::move(file);
+        _loaded = false;
+    }
+
+    // Write the pinned variants to the persistent file (if any), which is merged with the ones other processes wrote
+    void save();
+};
+
+} // jitk
+} // bohrium
@@ -21,6 +21,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <map>
 #include <string>
+#include <boost/filesystem/path.hpp>
 
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
@@ -35,10 +36,29 @@ private:
     std::map<size_t, std::string> _cache;
     // Some statistics
     jitk::Statistics &stat;
+    // The file that persists the cache between executions (the empty path disables persistence)
+    boost::filesystem::path _file;
+    // Has `_file` been loaded and has the cache changed since?
+    bool _loaded = false;
+    bool _dirty = false;
+    // The hash of the code generator variant, which is part of the key (see `setVariant()`)
+    uint64_t _variant = 0;
+
+    // Load the entries in `_file` that isn't in the cache already
+    void load();
 public:
     // The constructor takes the statistic object
     explicit CodegenCache(jitk::Statistics &stat) : stat(stat) {}
 
+    /** Key the following lookups and inserts by the code generator variant `variant_hash` as well.
+     * Zero is the configured code generator.
+     *
+     * @param variant_hash The hash of the variant
+     */
+    void setVariant(uint64_t variant_hash) {
+        _variant = variant_hash;
+    }
+
     /** Check the cache for a source code that matches `kernel`
      *
      * @param kernel  The kernel
@@ -54,6 +74,19 @@ public:
      * @param symbols The symbol table
      */
     void insert(std::string source, const LoopB &kernel, const SymbolTable &symbols);
+
+    /** Persist the cache in `file`, which is loaded on the first lookup and written by `save()`.
+     * NB: `file` should identify the code generator configuration since the cache is keyed by the kernel only.
+     *
+     * @param file The file path
+     */
+    void persist(boost::filesystem::path file) {
+        _file = std::move(file);
+        _loaded = false;
+    }
+
+    // Write the cache to the persistent file (if any), which is merged with the entries written by other processes
+    void save();
 };
 
 } // jit
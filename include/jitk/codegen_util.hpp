@@ -64,6 +64,9 @@ boost::filesystem::path write_source2file(const std::string &src,
 // Returns the path to the tmp dir
 boost::filesystem::path get_tmp_path(const ConfigParser &config);
 
+// Write `content` to `file` atomically thus readers (also in other processes) never see a partial file
+void write_file_atomically(const std::string &content, const boost::filesystem::path &file);
+
 // Tries five times to create directories recursively
 // Useful when multiple processes runs on the same filesystem
 void create_directories(const boost::filesystem::path &path);
@@ -0,0 +1,109 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <set>
+#include <memory>
+
+#include <jitk/block.hpp>
+#include <bh_config_parser.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+// A summary of a loop block that makes it cheap to estimate the cost of merging blocks
+struct BlockProfile {
+    // The arrays accessed, created, and freed in the block
+    std::set<bh_base *> bases, news, frees;
+    // The number of (non-system) instructions
+    uint64_t num_instrs = 0;
+    // The number of elements computed by all instructions
+    uint64_t num_elements = 0;
+    // The amount of parallelism in the block (see `parallel_ranks()`)
+    uint64_t parallelism = 0;
+
+    // Create the profile of `block`
+    explicit BlockProfile(const LoopB &block);
+
+    // Turn this profile into the profile of the merge of this and `other` without merging the blocks.
+    // NB: the parallelism is approximated by the parallelism of the least parallel block
+    void merge(const BlockProfile &other);
+};
+
+// The cost model the greedy fuser use to prioritize merges
+class FusionCostModel {
+public:
+    virtual ~FusionCostModel() = default;
+
+    /** Return the benefit of merging the blocks `a` and `b` (in that order), which the greedy fuser maximizes.
+     * A negative benefit means that the merge would slow down the execution thus the fuser should avoid it.
+     *
+     * @param a The profile of the first block
+     * @param b The profile of the second block
+     * @return The benefit
+     */
+    virtual double benefit(const BlockProfile &a, const BlockProfile &b) const = 0;
+};
+
+// The classic cost model: the benefit is the bytes of the arrays that become temporary, which is never negative
+class BytesCostModel : public FusionCostModel {
+public:
+    double benefit(const BlockProfile &a, const BlockProfile &b) const override;
+};
+
+/* A machine model that estimates the execution time (in cycles) of a block as a roofline of memory traffic
+ * and computation where:
+ *   - the cost of memory traffic depends on the cache level the working set fits in
+ *   - many concurrent streams (i.e. non-temporary arrays) penalize memory traffic (prefetching and TLB pressure)
+ *   - the computation is divided between the cores available to the parallelism of the block
+ *   - many live arrays penalize computation (register pressure)
+ * The benefit of a merge is the estimated cost of the two blocks minus the cost of the merged block.
+ */
+class MachineCostModel : public FusionCostModel {
+public:
+    // The parameters of the machine
+    struct Machine {
+        // The cache sizes in bytes (L2 and L1 are per core whereas L3 is shared)
+        uint64_t l1_size, l2_size, l3_size;
+        // The number of cores
+        uint64_t num_cores;
+    };
+private:
+    const Machine _machine;
+public:
+    explicit MachineCostModel(Machine machine) : _machine(machine) {}
+
+    // Return the machine parameters found in `config` (the value zero means detect the parameter)
+    static Machine getMachine(const ConfigParser &config);
+
+    // Return the estimated cost of a block
+    double cost(const BlockProfile &block) const;
+
+    // Return the estimated cost of the merge of `a` and `b` without creating the profile of the merge
+    double cost(const BlockProfile &a, const BlockProfile &b) const;
+
+    double benefit(const BlockProfile &a, const BlockProfile &b) const override;
+};
+
+// Create the cost model specified by the `fuser_cost_model` option in `config` ('bytes' or 'machine')
+std::unique_ptr<FusionCostModel> create_cost_model(const ConfigParser &config);
+
+} // jit
+} // bohrium
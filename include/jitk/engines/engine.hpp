@@ -20,11 +20,13 @@ If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 
 #include <bh_config_parser.hpp>
+#include <bh_version.h>
 #include <jitk/statistics.hpp>
 #include <jitk/instruction.hpp>
 #include <jitk/view.hpp>
 #include <jitk/fuser_cache.hpp>
 #include <jitk/codegen_cache.hpp>
+#include <jitk/autotuner.hpp>
 
 #include <bh_view.hpp>
 #include <bh_component.hpp>
@@ -44,6 +46,8 @@ protected:
     FuseCache fcache;
     CodegenCache codegen_cache;
     const bool verbose;
+    // The autotuner of hot flushes (used by the CPU engines)
+    Autotuner autotuner;
 
     // Maximum number of cache files
     const int64_t cache_file_max;
@@ -76,6 +80,7 @@ public:
             fcache(stat),
             codegen_cache(stat),
             verbose(comp.config.defaultGet<bool>("verbose", false)),
+            autotuner(comp.config, verbose),
             cache_file_max(comp.config.defaultGet<int64_t>("cache_file_max", 50000)),
             tmp_dir(get_tmp_path(comp.config)),
             tmp_src_dir(tmp_dir / "src"),
@@ -88,9 +93,20 @@ public:
         if (not cache_bin_dir.empty()) {
             jitk::create_directories(cache_bin_dir);
         }
+        // The persistent fuser and codegen caches and the autotuned variants are identified by the Bohrium version
+        // and the configuration of the engine
+        if (not cache_bin_dir.empty() and comp.config.defaultGet<bool>("persistent_caches", true)) {
+            std::stringstream ss;
+            ss << comp.config.getName() << "_" << BH_VERSION_STRING << "_" << std::hex
+               << util::hash(comp.config.sectionAsString(comp.config.getName()));
+            fcache.persist(cache_bin_dir / (ss.str() + ".fuser_cache"));
+            codegen_cache.persist(cache_bin_dir / (ss.str() + ".codegen_cache"));
+            autotuner.persist(cache_bin_dir / (ss.str() + ".autotune"));
+        }
     }
 
-    virtual ~Engine() = default;
+    // The destructor writes the persistent caches and the autotuned variants
+    virtual ~Engine();
 
     /** Return general information of the engine (should be human readable) */
     virtual std::string info() const = 0;
@@ -159,6 +175,42 @@ protected:
                             bool opencl,
                             std::stringstream &out);
 
+    /** Writes the innermost loop `loop` where the views of each group in `stencil_groups` read the same base array at
+     * consecutive offsets along the loop. Each element is loaded once into a rotating register.
+     *
+     * @param symbols         The symbol table
+     * @param scope           The scope of the parent block
+     * @param loop            The innermost loop to write
+     * @param stencil_groups  The groups of views ordered by offset (see `stencil_groups()`)
+     * @param thread_stack    A vector that specifies the amount of parallelism in each nest level (excl. rank -1)
+     * @param out             The stream output
+     */
+    void writeStencilLoop(const SymbolTable &symbols,
+                          const Scope &scope,
+                          const LoopB &loop,
+                          const std::vector<std::vector<bh_view> > &stencil_groups,
+                          const std::vector<uint64_t> &thread_stack,
+                          std::stringstream &out);
+
+    /** Writes the innermost loop `loop` unrolled by `num_accumulators` where each unrolled iteration updates its own
+     * partial accumulator of the reductions in `reductions`. The partial accumulators are combined after the loop.
+     *
+     * @param symbols           The symbol table
+     * @param scope             The scope of the parent block, which scalar-replaces the outputs of `reductions`
+     * @param loop              The innermost loop to write
+     * @param reductions        The reductions over the loop axis (see `accumulator_reductions()`)
+     * @param num_accumulators  The number of partial accumulators per reduction
+     * @param thread_stack      A vector that specifies the amount of parallelism in each nest level (excl. rank -1)
+     * @param out               The stream output
+     */
+    void writeAccumulatorLoop(const SymbolTable &symbols,
+                              const Scope &scope,
+                              const LoopB &loop,
+                              const std::vector<InstrPtr> &reductions,
+                              int num_accumulators,
+                              const std::vector<uint64_t> &thread_stack,
+                              std::stringstream &out);
+
     /** Write a loop header
      *
      * @param symbols       The symbol table
@@ -173,6 +225,47 @@ protected:
                                 const std::vector<uint64_t> &thread_stack,
                                 std::stringstream &out) = 0;
 
+    /** Write the loop `block` using an engine specific strategy (e.g. a parallel scan). The default writes nothing.
+     *
+     * @param symbols       The symbol table
+     * @param scope         The scope of the parent block
+     * @param block         The block
+     * @param thread_stack  A vector that specifies the amount of parallelism in each nest level (excl. rank -1)
+     * @param out           The stream output
+     * @return              Whether the loop was written
+     */
+    virtual bool loopWriter(const SymbolTable &symbols,
+                            Scope &scope,
+                            const LoopB &block,
+                            const std::vector<uint64_t> &thread_stack,
+                            std::stringstream &out) {
+        return false;
+    }
+
+    /** Write code that goes before a loop (and its fast path copies). The default writes nothing.
+     *
+     * @param symbols       The symbol table
+     * @param scope         The scope of the parent block
+     * @param block         The block
+     * @param out           The stream output
+     */
+    virtual void loopPrologueWriter(const SymbolTable &symbols,
+                                    Scope &scope,
+                                    const LoopB &block,
+                                    std::stringstream &out) {}
+
+    /** Write code that goes after a loop (and its fast path copies). The default writes nothing.
+     *
+     * @param symbols       The symbol table
+     * @param scope         The scope of the parent block
+     * @param block         The block
+     * @param out           The stream output
+     */
+    virtual void loopEpilogueWriter(const SymbolTable &symbols,
+                                    Scope &scope,
+                                    const LoopB &block,
+                                    std::stringstream &out) {}
+
     /** Write the source code of an instruction
      *
      * @param scope     The scope
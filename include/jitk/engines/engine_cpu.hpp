@@ -24,6 +24,8 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <bh_config_parser.hpp>
 #include <jitk/statistics.hpp>
 #include <jitk/apply_fusion.hpp>
+#include <jitk/plan_cache.hpp>
+#include <jitk/scratch_arena.hpp>
 
 #include <bh_view.hpp>
 #include <bh_component.hpp>
@@ -34,8 +36,19 @@ namespace bohrium {
 namespace jitk {
 
 class EngineCPU : public Engine {
+protected:
+    PlanCache plan_cache;
+    // Use the plan cache to skip fusion, codegen, and compilation of repeated flushes
+    const bool use_plan_cache;
+    // The scratch memory of the kernels, which is passed as the last `data_list` entry of each kernel call
+    ScratchArena scratch_arena;
+
 public:
-    EngineCPU(component::ComponentVE &comp, Statistics &stat) : Engine(comp, stat) {}
+    EngineCPU(component::ComponentVE &comp, Statistics &stat) :
+            Engine(comp, stat),
+            plan_cache(stat, comp.config.defaultGet<int64_t>("plan_cache_max", 1000)),
+            use_plan_cache(comp.config.defaultGet<bool>("plan_cache", true)),
+            scratch_arena(comp.config.defaultGet<uint64_t>("scratch_arena_limit", 268435456)) {}
 
     ~EngineCPU() override = default;
 
@@ -45,10 +58,56 @@ public:
                              uint64_t codegen_hash,
                              std::stringstream &ss) = 0;
 
-    virtual void execute(const jitk::SymbolTable &symbols,
-                         const std::string &source,
-                         uint64_t codegen_hash,
-                         const std::vector<const bh_instruction *> &constants) = 0;
+    /** Execute the kernel `source`
+     *
+     * @param symbols      The symbol table of the kernel
+     * @param source       The source code of the kernel
+     * @param codegen_hash The hash of the kernel used by the codegen cache
+     * @param constants    The instructions that contains the kernel constants
+     * @return The launcher function of the kernel, which the plan cache calls directly on repeated flushes
+     */
+    virtual KernelFunction execute(const jitk::SymbolTable &symbols,
+                                   const std::string &source,
+                                   uint64_t codegen_hash,
+                                   const std::vector<const bh_instruction *> &constants) = 0;
+
+    /** Prepare the launcher functions of the kernels in a flush before they are executed in order.
+     * The default implementation does nothing thus each kernel is compiled when it is executed.
+     *
+     * @param source_list The source code and codegen hash of each kernel (the empty source code
+     *                    when the kernel does no computation)
+     */
+    virtual void prepareFunctions(const std::vector<std::pair<std::string, uint64_t> > &source_list) {}
+
+    /** Called after each execution of a kernel, which makes it possible to replace its launcher function.
+     * The default implementation always keeps the launcher function.
+     *
+     * @param source_hash  The hash of the source code of the kernel
+     * @param kernel_stats The execution statistics of the kernel
+     * @param func         The launcher function that just executed the kernel
+     * @return The launcher function to use from now on
+     */
+    virtual KernelFunction updateFunction(uint64_t source_hash, const KernelStats &kernel_stats,
+                                          KernelFunction func) {
+        return func;
+    }
+
+    /** Execute `instr_list`, which has been cleaned up by `handleExecution()`
+     *
+     * @param instr_list   The instruction list to execute
+     * @param variant_hash The hash of the autotuner variant in use (zero is the configured baseline), which
+     *                     is part of the plan cache key
+     */
+    void executeInstrList(std::vector<bh_instruction *> &instr_list, uint64_t variant_hash);
+
+    /** Execute the cached `plan` of `instr_list`
+     *
+     * @param plan       The list of kernel plans
+     * @param key        The plan cache key of `instr_list`
+     * @param instr_list The instruction list to execute
+     */
+    void executePlan(std::vector<KernelPlan> &plan, const PlanCache::Key &key,
+                     const std::vector<bh_instruction *> &instr_list);
 
     void handleExecution(BhIR *bhir) override;
 
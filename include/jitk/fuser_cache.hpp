@@ -21,6 +21,7 @@ If not, see <http://www.gnu.org/licenses/>.
 
 #include <map>
 #include <vector>
+#include <boost/filesystem/path.hpp>
 
 #include <bh_instruction.hpp>
 #include <jitk/block.hpp>
@@ -39,6 +40,16 @@ private:
     };
     // The hash to payload map
     std::map<size_t, CachePayload> _cache;
+    // The file that persists the cache between executions (the empty path disables persistence)
+    boost::filesystem::path _file;
+    // Has `_file` been loaded and has the cache changed since?
+    bool _loaded = false;
+    bool _dirty = false;
+    // The hash of the fuser variant, which is part of the key (see `setVariant()`)
+    size_t _variant = 0;
+
+    // Load the entries in `_file` that isn't in the cache already
+    void load();
 public:
     // Some statistics
     jitk::Statistics &stat;
@@ -46,10 +57,31 @@ public:
     // The constructor takes the statistic object
     FuseCache(jitk::Statistics &stat) : stat(stat) {}
 
+    // The hash of 'instr_list' that the cache uses as key, which is identical for repeated instruction lists
+    static size_t hash(const std::vector<bh_instruction *> &instr_list);
+
+    // Key the following lookups and inserts by the fuser variant 'variant_hash' as well (zero is the configured fuser)
+    void setVariant(size_t variant_hash) {
+        _variant = variant_hash;
+    }
+
     // Check the cache for a block list that matches 'instr_list'
     std::pair<std::vector<Block>, bool> get(const std::vector<bh_instruction *> &instr_list);
     // Insert 'block_list' as a hit when requesting 'instr_list'
     void insert(const std::vector<bh_instruction *> &instr_list, std::vector<Block> block_list);
+
+    /** Persist the cache in `file`, which is loaded on the first lookup and written by `save()`.
+     * NB: `file` should identify the fuser configuration since the cache is keyed by the instruction list only.
+     *
+     * @param file The file path
+     */
+    void persist(boost::filesystem::path file) {
+        _file = std::move(file);
+        _loaded = false;
+    }
+
+    // Write the cache to the persistent file (if any), which is merged with the entries written by other processes
+    void save();
 };
 
 
@@ -24,6 +24,7 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <string>
 
 #include <jitk/block.hpp>
+#include <jitk/cost_model.hpp>
 #include <bh_instruction.hpp>
 
 #include <boost/graph/graph_traits.hpp>
@@ -56,7 +57,8 @@ void merge_vertices(DAG &dag, Vertex a, Vertex b, const bool remove_b=true);
 
 /* Transitive reduce the 'dag', i.e. remove all redundant edges,
  *
- * Complexity: O(E * (E + V))
+ * Complexity: O(E * (E + V)) but each path search only visits the vertices positioned between the two
+ *             vertices of the edge in a topological order
  *
  */
 void transitive_reduction(DAG &dag);
@@ -133,9 +135,13 @@ std::vector<Block> topological(DAG &dag, bool avoid_rank0_sweep) {
     return ret;
 }
 
-// Merges the vertices in 'dag' greedily.
+// Merges the vertices in 'dag' greedily by repeatedly merging over the greatest weight edge that isn't transitive.
+// The weight of an edge is the benefit of the merge according to 'cost_model' and edges with a negative benefit
+// are never merged.
+// The edges are kept in a priority queue and transitive edges are found using a topological order that is
+// maintained incrementally, which makes the fuser scale to large DAGs.
 // 'avoid_rank0_sweep' will avoid fusion of sweeped and non-sweeped blocks at the root level
-void greedy(DAG &dag, bool avoid_rank0_sweep);
+void greedy(DAG &dag, bool avoid_rank0_sweep, const FusionCostModel &cost_model);
 
 } // graph
 } // jit
@@ -35,6 +35,12 @@ bh_constant sweep_identity(bh_opcode opcode, bh_type dtype);
 std::vector<bh_instruction *> remove_non_computed_system_instr(std::vector<bh_instruction> &instr_list,
                                                                std::set<bh_base *> &frees);
 
+/// Rewrite the instructions of 'instr_list' such that an array, which dies at an elementwise instruction, is
+/// overwritten by the output of the instruction. The output array is written in place of the dead array by all
+/// instructions and takes over its memory, which removes an allocation and lowers the peak memory usage.
+/// Returns the number of dead arrays that were reused.
+uint64_t rewrite_inplace(std::vector<bh_instruction *> &instr_list);
+
 /// Reshape 'instr' to match 'size_of_rank_dim' at the 'rank' dimension.
 /// The dimensions from zero to 'rank-1' are untouched.
 InstrPtr reshape_rank(const InstrPtr &instr, int rank, int64_t size_of_rank_dim);
@@ -0,0 +1,125 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <set>
+#include <string>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+/** Persistent write-through cache of compiled kernels that many processes can share.
+ *
+ * New kernels are published immediately using an atomic rename thus a crashed process never leaves a partial
+ * kernel behind. Lookups are a single `stat()` of the kernel file and every use is appended to an on-disk index,
+ * which makes up the LRU order. When the index outgrows `max_files`, it is compacted and the least recently used
+ * kernels are evicted. The index and the lock files are placed in the sub-directory `<dir>/<name>_index`.
+ */
+class KernelCache {
+public:
+    // An exclusive or shared `flock()` of a lock file, which is released on destruction
+    class Lock {
+    private:
+        int _fd;
+        // When not empty, the lock file is removed on release
+        const boost::filesystem::path _remove_on_release;
+    public:
+        // When not `wait`, the constructor gives up if the lock is taken already (see `locked()`)
+        Lock(const boost::filesystem::path &path, bool exclusive, bool remove_on_release, bool wait = true);
+        ~Lock();
+        // Return true when the lock is held
+        bool locked() const {
+            return _fd >= 0;
+        }
+        Lock(const Lock &) = delete;
+        Lock &operator=(const Lock &) = delete;
+    };
+
+private:
+    // The cache directory (the empty path disables the cache)
+    const boost::filesystem::path _dir;
+    // The directory of the index and the lock files
+    const boost::filesystem::path _index_dir;
+    // The maximum number of kernels to keep (-1 means infinity)
+    const int64_t _max_files;
+    // The file extensions of the kernels owned by this cache (other files in `_dir` are never evicted)
+    const std::set<std::string> _extensions;
+
+    // Append `filename` to the index and compact the index when it becomes too large
+    void touch(const std::string &filename) const;
+
+    // Compact the index and evict the least recently used kernels that no process is compiling or publishing
+    void compact(uint64_t max_index_size) const;
+
+    // Return the path of the lock file that `lockCompilation()` locks
+    boost::filesystem::path lockFile(const std::string &filename) const {
+        return _index_dir / (filename + ".lock");
+    }
+
+public:
+    /** Constructor that takes:
+     *
+     * @param dir        The cache directory (the empty path disables the cache)
+     * @param max_files  The maximum number of kernels to keep (-1 means infinity)
+     * @param name       The name of the cache (e.g. the name of the engine), which must be unique within `dir`
+     * @param extensions The file extensions of the kernels (e.g. ".so")
+     */
+    KernelCache(boost::filesystem::path dir, int64_t max_files, const std::string &name,
+                std::set<std::string> extensions);
+
+    // Return true when the cache is enabled
+    bool enabled() const {
+        return not _dir.empty();
+    }
+
+    /** Check the cache for `filename` without marking it as used
+     *
+     * @param filename The filename of the kernel
+     * @return True on cache hits
+     */
+    bool contains(const std::string &filename) const;
+
+    /** Check the cache for `filename` and mark it as used
+     *
+     * @param filename The filename of the kernel
+     * @return The path of the kernel or the empty path on cache misses
+     */
+    boost::filesystem::path lookup(const std::string &filename) const;
+
+    /** Publish the compiled kernel `file` as `filename`, which is atomic even across processes
+     *
+     * @param file     The compiled kernel (e.g. in the tmp dir)
+     * @param filename The filename of the kernel in the cache
+     */
+    void publish(const boost::filesystem::path &file, const std::string &filename) const;
+
+    /** Lock the compilation of `filename` across processes. Use it around "lookup, compile, and publish"
+     * to make sure that only one process compiles a kernel while the others wait and use the published kernel.
+     *
+     * @param filename The filename of the kernel
+     * @return The lock, which is released on destruction (nullptr when the cache is disabled)
+     */
+    std::unique_ptr<Lock> lockCompilation(const std::string &filename) const;
+};
+
+} // jit
+} // bohrium
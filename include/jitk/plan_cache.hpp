@@ -0,0 +1,129 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+
+#include <bh_instruction.hpp>
+#include <jitk/block.hpp>
+#include <jitk/symbol_table.hpp>
+#include <jitk/statistics.hpp>
+
+namespace bohrium {
+namespace jitk {
+
+// The launcher function of a compiled CPU kernel
+typedef void (*KernelFunction)(void *data_list[], uint64_t offset_strides[], bh_constant_value constants[]);
+
+// The execution plan of a single kernel, which contains everything needed to call the kernel launcher directly.
+// Notice, bases are referred to by their flush-level ID, which is the order they appear in the instruction list.
+struct KernelPlan {
+    // The launcher function or nullptr when the kernel does no computation
+    KernelFunction func = nullptr;
+    // The hash of the source code and the source filename of the kernel (used as key in `Statistics::time_per_kernel`)
+    uint64_t source_hash = 0;
+    std::string source_filename;
+    // The flush-level base IDs of the kernel parameters, which makes up the `data_list`
+    std::vector<size_t> params;
+    // The offset-and-strides of the kernel
+    std::vector<uint64_t> offset_and_strides;
+    // The constants of the kernel
+    std::vector<bh_constant_value> constants;
+    // The index of the instruction each constant should be read from (-1 when the constant is fixed)
+    std::vector<int64_t> constant_origins;
+    // The flush-level base IDs of the arrays freed by the kernel
+    std::vector<size_t> frees;
+    // The symbol table statistics of the kernel (see `Statistics::record()`)
+    uint64_t num_base_arrays = 0;
+    uint64_t num_temp_arrays = 0;
+};
+
+class PlanCache {
+public:
+    // The lookup key of an instruction list
+    struct Key {
+        uint64_t hash;
+        // The bases in the order of their flush-level ID
+        std::vector<bh_base *> bases;
+        // Mapping a base to its flush-level ID
+        std::map<const bh_base *, size_t> base_ids;
+        // The number of instructions in the instruction list
+        size_t num_instrs;
+    };
+
+private:
+    // The hashes in the order of use, the most recently used first
+    std::list<uint64_t> _lru;
+    // The hash to plan map, which also points to the hash in `_lru`
+    std::map<uint64_t, std::pair<std::vector<KernelPlan>, std::list<uint64_t>::iterator> > _cache;
+    // The maximum number of plans to keep (-1 means infinity)
+    const int64_t _max_plans;
+    // Some statistics
+    jitk::Statistics &stat;
+
+public:
+    // The constructor takes the statistic object and the maximum number of plans to keep (-1 means infinity)
+    PlanCache(jitk::Statistics &stat, int64_t max_plans) : _max_plans(max_plans), stat(stat) {}
+
+    // The maximum number of plans to keep (-1 means infinity)
+    int64_t maxPlans() const { return _max_plans; }
+
+    /** Create the lookup key of `instr_list`
+     *
+     * @param instr_list   The instruction list
+     * @param const_as_var Whether the kernels take the constants as variables
+     * @param key          The output key
+     * @return False when `instr_list` cannot be cached (e.g. it contains sliding views)
+     */
+    static bool createKey(const std::vector<bh_instruction *> &instr_list, bool const_as_var, Key &key);
+
+    /** Create the plan of `kernel`
+     *
+     * @param key             The key of the instruction list that `kernel` is part of
+     * @param kernel          The kernel
+     * @param symbols         The symbol table of the kernel
+     * @param func            The launcher function of the kernel (or nullptr when the kernel does no computation)
+     * @param source_hash     The hash of the source code of the kernel
+     * @param source_filename The source filename of the kernel
+     * @return The kernel plan
+     */
+    static KernelPlan createKernelPlan(const Key &key, const LoopB &kernel, const SymbolTable &symbols,
+                                       KernelFunction func, uint64_t source_hash, std::string source_filename);
+
+    /** Check the cache for a plan that matches `key`
+     *
+     * @param key The key
+     * @return The list of kernel plans or nullptr on cache misses
+     */
+    std::vector<KernelPlan> *lookup(const Key &key);
+
+    /** Insert `plan` as a hit when requesting `key` and evict the least recently used plan if the cache is full
+     *
+     * @param key  The key
+     * @param plan The list of kernel plans
+     */
+    void insert(const Key &key, std::vector<KernelPlan> plan);
+};
+
+} // jit
+} // bohrium
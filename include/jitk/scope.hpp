@@ -40,7 +40,13 @@ private:
     std::set<bh_view, IgnoreOneDim_less> _scalar_replacements; // Set of scalar replaced arrays
     std::set<InstrPtr> _omp_atomic; // Set of instructions that should be guarded by OpenMP atomic
     std::set<InstrPtr> _omp_critical; // Set of instructions that should be guarded by OpenMP critical
+    std::set<InstrPtr> _omp_partial; // Set of instructions that reduce into per-thread partial results
+    std::set<const bh_base *> _scan_carries; // Set of accumulated arrays that continue from a carry variable
+    std::set<int> _blocked_loops; // Set of ranks of loops that iterate a block of their axis
     std::set<bh_view, OffsetAndStrides_less> _declared_idx; // Set of indexes that have been locally declared
+    std::map<bh_view, int, OffsetAndStrides_less> _partial_idx; // Locally declared partial indexes and their rank
+    bool _sequential{false}; // The loops carry values between iterations (e.g. the rotating registers of stencils)
+    std::map<bh_view, int, IgnoreOneDim_less> _accumulators; // Scalar-replaced reductions using a partial accumulator
 public:
     Scope(const SymbolTable &symbols, const Scope *parent) : symbols(symbols), parent(parent) {}
 
@@ -86,6 +92,39 @@ public:
         return not(isTmp(view.base) or isScalarReplaced(view));
     }
 
+    /// Mark that the loops in this scope carry values between iterations thus must run sequentially
+    void setSequential() {
+        _sequential = true;
+    }
+
+    /// Check if the loops must run sequentially
+    bool isSequential() const {
+        if (_sequential) {
+            return true;
+        } else if (parent != nullptr) {
+            return parent->isSequential();
+        } else {
+            return false;
+        }
+    }
+
+    /// Let the scalar-replaced reduction output 'view' use its 'number'th partial accumulator in this scope
+    void setAccumulator(const bh_view &view, int number) {
+        _accumulators[view] = number;
+    }
+
+    /// Get the number of the partial accumulator that 'view' uses or zero if it uses the scalar-replaced variable itself
+    int accumulator(const bh_view &view) const {
+        auto it = _accumulators.find(view);
+        if (it != _accumulators.end()) {
+            return it->second;
+        } else if (parent != nullptr) {
+            return parent->accumulator(view);
+        } else {
+            return 0;
+        }
+    }
+
     /// Insert that 'instr' should be guarded by OpenMP atomic
     void insertOpenmpAtomic(const InstrPtr &instr) {
         _omp_atomic.insert(instr);
@@ -118,6 +157,60 @@ public:
         }
     }
 
+    /// Insert that 'instr' reduces into per-thread partial results thus needs no guard
+    void insertOpenmpPartial(const InstrPtr &instr) {
+        _omp_partial.insert(instr);
+    }
+
+    /// Remove 'instr' from the set of instructions that reduces into per-thread partial results
+    void eraseOpenmpPartial(const InstrPtr &instr) {
+        _omp_partial.erase(instr);
+    }
+
+    /// Check if 'instr' reduces into per-thread partial results
+    bool isOpenmpPartial(const InstrPtr &instr) const {
+        if (_omp_partial.find(instr) != _omp_partial.end()) {
+            return true;
+        } else if (parent != nullptr) {
+            return parent->isOpenmpPartial(instr);
+        } else {
+            return false;
+        }
+    }
+
+    /// Insert that the accumulation into `base` continues from a carry variable at the beginning of a chunk
+    void insertScanCarry(const bh_base *base) {
+        _scan_carries.insert(base);
+    }
+
+    /// Check if the accumulation into `base` continues from a carry variable at the beginning of a chunk
+    bool isScanCarry(const bh_base *base) const {
+        if (util::exist(_scan_carries, base)) {
+            return true;
+        } else if (parent != nullptr) {
+            return parent->isScanCarry(base);
+        } else {
+            return false;
+        }
+    }
+
+    /// Mark that the loops of `rank` iterate the block of their axis between the variables `i<rank>_begin` and
+    /// `i<rank>_end` rather than the whole axis
+    void setBlockedLoop(int rank) {
+        _blocked_loops.insert(rank);
+    }
+
+    /// Check if the loops of `rank` iterate a block of their axis
+    bool isBlockedLoop(int rank) const {
+        if (util::exist(_blocked_loops, rank)) {
+            return true;
+        } else if (parent != nullptr) {
+            return parent->isBlockedLoop(rank);
+        } else {
+            return false;
+        }
+    }
+
     /// Check if 'view' has been locally declared (e.g. a temporary or scalar-replaced variable)
     bool isDeclared(const bh_view &view) const {
         return isTmp(view.base) or isScalarReplaced(view);
@@ -134,6 +227,18 @@ public:
         }
     }
 
+    /// Get the rank of the innermost declared partial index of 'index' or -1 if none is declared
+    int partialIdxRank(const bh_view &index) const {
+        auto it = _partial_idx.find(index);
+        if (it != _partial_idx.end()) {
+            return it->second;
+        } else if (parent != nullptr) {
+            return parent->partialIdxRank(index);
+        } else {
+            return -1;
+        }
+    }
+
     /// Get the name (symbol) of the 'base'
     template<typename T>
     void getName(const bh_view &view, T &out) const {
@@ -142,6 +247,10 @@ public:
         } else if (isScalarReplaced(view)) {
             out << "s" << symbols.baseID(view.base);
             out << "_" << symbols.viewID(view);
+            const int number = accumulator(view);
+            if (number > 0) {
+                out << "_" << number;
+            }
         } else {
             out << "a" << symbols.baseID(view.base);
         }
@@ -176,6 +285,17 @@ public:
 
     // Write the variable declaration of the index calculation of 'view' using 'type_str' as the type string
     void writeIdxDeclaration(const bh_view &view, const std::string &type_str, int hidden_axis, std::stringstream &out);
+
+    // Get the name of the partial index of 'view' that covers the axes up to and including 'rank'
+    template<typename T>
+    void getPartialIdxName(const bh_view &view, int rank, T &out) const {
+        out << "pidx" << symbols.idxID(view) << "_" << rank;
+    }
+
+    // Write the variable declaration of the partial index of 'view', which is the index calculation of the axes up to
+    // and including 'rank' (the rank of the current block). Inner blocks then only add their own axes to it.
+    void writePartialIdxDeclaration(const bh_view &view, const std::string &type_str, int rank,
+                                    std::stringstream &out);
 };
 
 
@@ -0,0 +1,89 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+namespace bohrium {
+namespace jitk {
+
+/** The interface of the scratch arena in the kernels, which must match the `bh_scratch` struct written by the CPU
+ * engines. The kernels get a pointer to it as the last entry of their `data_list`.
+ */
+struct ScratchInterface {
+    void *arena;
+    void *(*alloc)(void *arena, uint64_t nbytes);
+    void (*free)(void *arena, void *mem);
+};
+
+/** Scratch memory of the kernels (e.g. per-thread partial results), which is kept between kernel calls thus repeated
+ * calls neither pay for an allocation nor for page faults.
+ *
+ * The kernels allocate and free scratch memory in LIFO order. When a call outgrows the arena, the rest of its
+ * allocations use malloc() and the arena grows to the peak usage of the call when it returns (up to `limit` bytes).
+ */
+class ScratchArena {
+private:
+    // The memory of the arena, its size and the number of bytes in use
+    char *_mem = nullptr;
+    uint64_t _size = 0;
+    uint64_t _top = 0;
+    // The allocations of the current call that didn't fit in the arena and their sizes
+    std::vector<std::pair<void *, uint64_t> > _overflow;
+    // The bytes in use including `_overflow` and its peak in the current call
+    uint64_t _used = 0;
+    uint64_t _peak = 0;
+    // The maximum size of the arena
+    const uint64_t _limit;
+    ScratchInterface _interface;
+
+public:
+    /** Constructor
+     *
+     * @param limit The maximum size of the arena in bytes, allocations beyond it always use malloc()
+     */
+    explicit ScratchArena(uint64_t limit);
+    ~ScratchArena();
+    ScratchArena(const ScratchArena &) = delete;
+    ScratchArena &operator=(const ScratchArena &) = delete;
+
+    /** Allocate `nbytes` of scratch memory aligned to a cache line */
+    void *alloc(uint64_t nbytes);
+
+    /** Free the scratch memory `mem`, which must be the latest allocation not yet freed */
+    void free(void *mem);
+
+    /** Release the allocations of the call that just returned and grow the arena to fit its peak usage */
+    void reset();
+
+    /** Return the interface to pass to the kernels */
+    ScratchInterface *interface() {
+        return &_interface;
+    }
+
+    /** Return the size of the arena in bytes */
+    uint64_t size() const {
+        return _size;
+    }
+};
+
+}
+} // namespace
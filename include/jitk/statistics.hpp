@@ -84,6 +84,8 @@ class Statistics {
     uint64_t codegen_cache_misses      = 0;
     uint64_t kernel_cache_lookups      = 0;
     uint64_t kernel_cache_misses       = 0;
+    uint64_t plan_cache_lookups        = 0;
+    uint64_t plan_cache_misses         = 0;
     uint64_t num_instrs_into_fuser     = 0;
     uint64_t num_blocks_out_of_fuser   = 0;
     uint64_t malloc_cache_lookups      = 0;
@@ -131,6 +133,7 @@ class Statistics {
             out << "Fuse cache hits:                 " << GRN << fuseCacheHits()                     << "\n" << RST;
             out << "Codegen cache hits:              " << GRN << codegenCacheHits()                  << "\n" << RST;
             out << "Compilation cache hits:          " << GRN << kernelCacheHits()                   << "\n" << RST;
+            out << "Plan cache hits:                 " << GRN << planCacheHits()                     << "\n" << RST;
             out << "Array contractions:              " << GRN << arrayContractions()                 << "\n" << RST;
             out << "Outer-fusion ratio:              " << GRN << outerFusionRatio()                  << "\n" << RST;
             out << "Malloc cache hits:               " << GRN << MallocCacheHits()                   << "\n" << RST;
@@ -221,6 +224,7 @@ class Statistics {
             file << "  fuse_cache_hits: "       << fuseCacheHits()                   << "\n";
             file << "  codegen_cache_hits: "    << codegenCacheHits()                << "\n";
             file << "  kernel_cache_hits: "     << kernelCacheHits()                 << "\n";
+            file << "  plan_cache_hits: "       << planCacheHits()                   << "\n";
             file << "  array_contractions: "    << arrayContractions()               << "\n";
             file << "  outer_fusion_ratio: "    << outerFusionRatio()                << "\n";
             file << "  memory_usage: "          << memoryUsage()                     << "\n"; // mb
@@ -288,6 +292,10 @@ class Statistics {
         return pprint_ratio(kernel_cache_lookups - kernel_cache_misses, kernel_cache_lookups);
     }
 
+    std::string planCacheHits() {
+        return pprint_ratio(plan_cache_lookups - plan_cache_misses, plan_cache_lookups);
+    }
+
     std::string arrayContractions() {
         return pprint_ratio(num_temp_arrays, num_base_arrays);
     }
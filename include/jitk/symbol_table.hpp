@@ -137,8 +137,11 @@ public:
     const bool index_as_var;
     // Should we use constants as variables?
     const bool const_as_var;
+    // Should we reuse the loads of stencils through rotating registers? (the kernels depend on the array offsets)
+    const bool stencil_reuse;
 
-    SymbolTable(const LoopB &kernel, bool use_volatile, bool strides_as_var, bool index_as_var, bool const_as_var);
+    SymbolTable(const LoopB &kernel, bool use_volatile, bool strides_as_var, bool index_as_var, bool const_as_var,
+                bool stencil_reuse = false);
 
     // Get the ID of 'base', throws exception if 'base' doesn't exist
     size_t baseID(const bh_base *base) const {
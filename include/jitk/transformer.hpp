@@ -38,5 +38,19 @@ void split_for_threading(std::vector<Block> &block_list, uint64_t min_threading=
 // Collapses redundant axes within the 'block_list'
 void collapse_redundant_axes(std::vector<Block> &block_list);
 
+// Permutes the loops of the loop nests within 'block_list' such that the arrays are traversed with the smallest
+// strides innermost (e.g. column-major arrays). Swept axes are never moved thus reductions and accumulates are kept.
+void interchange_loops(std::vector<Block> &block_list);
+
+// Tiles the loop nests within 'block_list' that reuse data between iterations (stencils and transposed accesses)
+// but whose working set doesn't fit 'cache_size' bytes. The innermost axes are strip-mined into tiles, which are
+// traversed by new outermost loops. The number of tiles is kept above 'min_tiles' (if possible) for threading.
+void tile(std::vector<Block> &block_list, uint64_t cache_size, uint64_t min_tiles=1);
+
+// Hoists loop-invariant instructions out of the loops within 'block_list' (loop-invariant code motion). An instruction
+// is invariant to a loop when its inputs are broadcasted along the axis of the loop (e.g. `c[:, None]**2`) and its
+// output is a temporary array, which is then computed once per iteration of the parent loop.
+void hoist_loop_invariants(std::vector<Block> &block_list);
+
 } // jitk
 } // bohrium
@@ -0,0 +1,84 @@
+/*
+This file is part of Bohrium and copyright (c) 2012 the Bohrium
+team <http://www.bh107.org>.
+
+Bohrium is free software: you can redistribute it and/or modify
+it under the terms of the GNU Lesser General Public License as
+published by the Free Software Foundation, either version 3
+of the License, or (at your option) any later version.
+
+Bohrium is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the
+GNU Lesser General Public License along with Bohrium.
+
+If not, see <http://www.gnu.org/licenses/>.
+*/
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <future>
+#include <functional>
+#include <condition_variable>
+
+namespace bohrium {
+namespace jitk {
+
+/** A fixed pool of worker threads that executes submitted tasks in FIFO order.
+ *  The workers are started on the first submit thus an unused pool is free. */
+class WorkerPool {
+private:
+    // The number of workers
+    const size_t _num_workers;
+    // The worker threads
+    std::vector<std::thread> _workers;
+    // The tasks that await a worker
+    std::deque<std::function<void()> > _tasks;
+    // Set when the workers should exit (after finishing all tasks)
+    bool _stop = false;
+    std::mutex _mutex;
+    std::condition_variable _cond;
+
+    // The main loop of a worker
+    void workerLoop();
+
+    // Add `task` to the task queue
+    void enqueue(std::function<void()> task);
+
+public:
+    /** Create a pool of `num_workers` workers (zero means the number of hardware threads) */
+    explicit WorkerPool(size_t num_workers);
+
+    /** Finishes all submitted tasks and joins the workers */
+    ~WorkerPool();
+
+    // Return the number of workers
+    size_t size() const {
+        return _num_workers;
+    }
+
+    /** Submit `task` for execution on a worker
+     *
+     * @param task The task, which is any callable that takes no arguments
+     * @return A future of the result of `task` (exceptions thrown by `task` are stored in the future)
+     */
+    template<typename Task>
+    auto submit(Task task) -> std::shared_future<decltype(task())> {
+        typedef decltype(task()) Result;
+        // NB: `std::function` must be copyable thus we share the packaged task
+        auto packaged = std::make_shared<std::packaged_task<Result()> >(std::move(task));
+        std::shared_future<Result> ret = packaged->get_future().share();
+        enqueue([packaged]() { (*packaged)(); });
+        return ret;
+    }
+};
+
+} // jit
+} // bohrium
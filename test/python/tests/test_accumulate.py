@@ -34,6 +34,32 @@ class test_sum:
         cmd += "res = a.%s(axis=%d)" % (op, axis)
         return cmd
 
+class test_scan_large:
+    """ Test accumulations long enough for the parallel scan (see `openmp_scan_threshold`)"""
+    def init(self):
+        for size in [100000, 200003]:
+            yield size
+
+    def test_cumsum(self, size):
+        cmd = "R = bh.random.RandomState(42); a = (R.random(%d, dtype=np.int64, bohrium=BH) & 1023) - 512; " % size
+        cmd += "bh.flush(); res = M.cumsum(a)"
+        return cmd
+
+    def test_cumsum_fused(self, size):
+        cmd = "R = bh.random.RandomState(42); a = (R.random(%d, dtype=np.int64, bohrium=BH) & 1023) - 512; " % size
+        cmd += "bh.flush(); res = M.cumsum(a * 3 + 1)"
+        return cmd
+
+    def test_cumprod(self, size):
+        cmd = "R = bh.random.RandomState(42); a = (R.random(%d, dtype=np.int64, bohrium=BH) & 1) * 2 - 1; " % size
+        cmd += "bh.flush(); res = M.cumprod(a)"
+        return cmd
+
+    def test_cumprod_fused(self, size):
+        cmd = "R = bh.random.RandomState(42); a = (R.random(%d, dtype=np.int64, bohrium=BH) & 1) * 2 - 1; " % size
+        cmd += "bh.flush(); res = M.cumprod(-a)"
+        return cmd
+
 class test_primitives:
     def init(self):
         for op in ["add", "multiply"]:
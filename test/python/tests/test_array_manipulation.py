@@ -111,3 +111,23 @@ class test_concatenate:
     def test_same_shape(self, args):
         (cmd, axis) = args
         return cmd + "res = M.concatenate([a, b], axis=%d)" % axis
+
+
+class test_inplace_rewrite:
+    """ Test elementwise operations that the runtime might compute in place of a dying array"""
+    def init(self):
+        for shape in [(1000,), (30, 40)]:
+            cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=np.float64, bohrium=BH); " % (shape,)
+            yield cmd
+
+    def test_chain(self, cmd):
+        cmd += "b = a + 1; del a; c = b * 2; del b; res = c - 3; del c"
+        return cmd
+
+    def test_data_from_prior_flush(self, cmd):
+        cmd += "bh.flush(); b = a * 2; del a; res = b + 1"
+        return cmd
+
+    def test_partial_view_read(self, cmd):
+        cmd += "bh.flush(); b = a[1:] * 2; c = a[:-1] + a[1:]; del a; res = b + c"
+        return cmd
@@ -0,0 +1,44 @@
+import util
+
+
+class test_scratch_partials:
+    """ Test column reductions into per-thread partial results, which are allocated from the scratch arena.
+        Run with a small BH_OPENMP_SCRATCH_ARENA_LIMIT (e.g. 100) to overflow the arena"""
+    def init(self):
+        for shape in [(1000, 7), (3000, 40)]:
+            yield shape
+
+    def test_add_and_maximum(self, shape):
+        cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=np.int64, bohrium=BH) & 1023; " % (shape,)
+        cmd += "res = M.add.reduce(a, axis=0) + M.maximum.reduce(a - 512, axis=0)"
+        return cmd
+
+
+class test_scratch_scans:
+    """ Test parallel scans, which allocate the totals of the chunks from the scratch arena.
+        Run with a small BH_OPENMP_SCRATCH_ARENA_LIMIT (e.g. 100) to overflow the arena"""
+    def init(self):
+        for size in [100000, 300007]:
+            yield size
+
+    def test_two_scans(self, size):
+        cmd = "R = bh.random.RandomState(42); a = (R.random(%d, dtype=np.int64, bohrium=BH) & 1023) - 512; " % size
+        cmd += "bh.flush(); res = M.cumsum(a) + M.cumsum(a * 2)"
+        return cmd
+
+
+class test_large_allocations:
+    """ Test arrays above `huge_pages_threshold` and `prefault_threshold`. Run with BH_OPENMP_HUGE_PAGES=madvise
+        (or hugetlb, which falls back to regular pages) and BH_OPENMP_PREFAULT_PAGES=true"""
+    def init(self):
+        for size in [300000, 3000000]:
+            yield size
+
+    def test_elementwise(self, size):
+        cmd = "a = M.arange(%d, dtype=np.float64); res = a * 2 + 1" % size
+        return cmd
+
+    def test_reuse(self, size):
+        cmd = "a = M.arange(%d, dtype=np.float64); b = a * 2; bh.flush(); del b; " % size
+        cmd += "c = M.ones(%d, dtype=np.float64); res = c + a" % size
+        return cmd
@@ -0,0 +1,36 @@
+import util
+
+
+class test_plan_cache:
+    """ Test repeated flushes, which replay the execution plan cache with new constants (see `plan_cache`).
+        Run with BH_OPENMP_CONST_AS_VAR=false and a small BH_OPENMP_PLAN_CACHE_MAX to cover all of the cache."""
+    def init(self):
+        for n in [10, 1000]:
+            yield n
+
+    def test_constant(self, n):
+        cmd = "a = M.arange(%d, dtype=np.int64); res = M.zeros(%d, dtype=np.int64)\n" % (n, n)
+        cmd += "for i in range(10):\n"
+        cmd += "    res += a * i + i\n"
+        cmd += "    bh.flush()\n"
+        return cmd
+
+    def test_constant_float(self, n):
+        cmd = "a = M.arange(%d, dtype=np.float64); res = M.zeros(%d, dtype=np.float64)\n" % (n, n)
+        cmd += "for i in range(10):\n"
+        cmd += "    res += a / (i + 1.0) - i / 4.0\n"
+        cmd += "    bh.flush()\n"
+        return cmd
+
+    def test_evict(self, n):
+        # Cycle through three distinct flushes thus a plan cache of one or two plans evicts plans that are used again
+        cmd = "a = M.arange(%d, dtype=np.int64); res = M.zeros(%d, dtype=np.int64)\n" % (n, n)
+        cmd += "for i, k in enumerate([0, 1, 0, 2, 1, 0, 2, 2, 1, 0, 1, 2]):\n"
+        cmd += "    if k == 0:\n"
+        cmd += "        res += a * i\n"
+        cmd += "    elif k == 1:\n"
+        cmd += "        res -= a + i\n"
+        cmd += "    else:\n"
+        cmd += "        res += (a[::-1] * i) % 7\n"
+        cmd += "    bh.flush()\n"
+        return cmd
@@ -44,3 +44,44 @@ class test_reduce_primitives:
         cmd = "R = bh.random.RandomState(42); a = R.random(10, dtype=%s, bohrium=BH)%s; " % (dtype, mul_factor)
         cmd += "res = M.%s.reduce(a)" % op
         return cmd
+
+
+class test_reduce_identity:
+    """ Test reductions where a wrong identity value changes the result. Besides the last axis of strided views,
+        the shapes cover the first axis of matrices narrower than the parallel column block, which reduce into
+        per-thread partial results, and of matrices wider than `openmp_column_block`, which are blocked"""
+    def init(self):
+        for shape in [(100,), (30, 50), (5, 2, 50)]:
+            yield (shape, len(shape) - 1, "[..., ::2]")
+        for shape in [(100, 7), (1000, 30), (30, 1000), (3, 2049), (20, 4099), (7, 5000)]:
+            yield (shape, 0, "")
+
+    def test_add_negative(self, arg):
+        (shape, axis, view) = arg
+        cmd = "R = bh.random.RandomState(42); a = -R.random(%s, dtype=np.float64, bohrium=BH) - 1; " % (shape,)
+        cmd += "res = M.add.reduce(a%s, axis=%d)" % (view, axis)
+        return cmd
+
+    def test_maximum_negative(self, arg):
+        (shape, axis, view) = arg
+        cmd = "R = bh.random.RandomState(42); a = -R.random(%s, dtype=np.float64, bohrium=BH) - 1; " % (shape,)
+        cmd += "res = M.maximum.reduce(a%s, axis=%d)" % (view, axis)
+        return cmd
+
+    def test_minimum_negative(self, arg):
+        (shape, axis, view) = arg
+        cmd = "R = bh.random.RandomState(42); a = -R.random(%s, dtype=np.float64, bohrium=BH) - 1; " % (shape,)
+        cmd += "res = M.minimum.reduce(a%s, axis=%d)" % (view, axis)
+        return cmd
+
+    def test_maximum_bool(self, arg):
+        (shape, axis, view) = arg
+        cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=np.float64, bohrium=BH) > 0.98; " % (shape,)
+        cmd += "res = M.maximum.reduce(a%s, axis=%d)" % (view, axis)
+        return cmd
+
+    def test_bitwise_and_int64(self, arg):
+        (shape, axis, view) = arg
+        cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=np.int64, bohrium=BH) | (2**62 + 2**40); " % (shape,)
+        cmd += "res = M.bitwise_and.reduce(a%s, axis=%d)" % (view, axis)
+        return cmd
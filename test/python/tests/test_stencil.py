@@ -0,0 +1,60 @@
+import util
+
+
+class test_stencil_1d:
+    """ Test one-dimensional stencils. Run with BH_OPENMP_STENCIL_REGISTER_REUSE=true to reuse the loaded
+        neighbours in registers"""
+    def init(self):
+        for size in [10, 1000, 100003]:
+            yield size
+
+    def test_three_point(self, size):
+        cmd = "a = M.arange(%d, dtype=np.float64) * 0.1; res = a[:-2] + a[1:-1] + a[2:]" % size
+        return cmd
+
+    def test_five_point_int(self, size):
+        cmd = "a = M.arange(%d, dtype=np.int64) %% 97; " % size
+        cmd += "res = a[:-4] - a[1:-3] * 2 + a[2:-2] * 3 - a[3:-1] * 2 + a[4:]"
+        return cmd
+
+
+class test_stencil_2d:
+    """ Test two-dimensional stencils. Run with BH_OPENMP_STENCIL_REGISTER_REUSE=true, or with 'tile' in
+        BH_OPENMP_FUSER_LIST and a small BH_OPENMP_TILE_CACHE_SIZE to tile the loop nests"""
+    def init(self):
+        for shape in [(5, 7), (100, 300), (400, 400)]:
+            yield shape
+
+    def test_five_point(self, shape):
+        cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=np.float64, bohrium=BH); " % (shape,)
+        cmd += "res = (a[1:-1, :-2] + a[1:-1, 1:-1] + a[1:-1, 2:] + a[:-2, 1:-1] + a[2:, 1:-1]) * 0.2"
+        return cmd
+
+    def test_jacobi_steps(self, shape):
+        cmd = "R = bh.random.RandomState(42); res = R.random(%s, dtype=np.float64, bohrium=BH)\n" % (shape,)
+        cmd += "for _ in range(3):\n"
+        cmd += "    res[1:-1, 1:-1] = (res[1:-1, :-2] + res[1:-1, 2:] + res[:-2, 1:-1] + res[2:, 1:-1]) * 0.25\n"
+        return cmd
+
+
+class test_elementwise_2d:
+    """ Test two-dimensional element-wise operations, including transposed accesses. Run with 'tile' in
+        BH_OPENMP_FUSER_LIST and a small BH_OPENMP_TILE_CACHE_SIZE to tile the loop nests"""
+    def init(self):
+        for shape in [(3, 3), (300, 300), (257, 1025)]:
+            yield shape
+
+    def test_add(self, shape):
+        cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=np.float64, bohrium=BH); " % (shape,)
+        cmd += "b = R.random(%s, dtype=np.float64, bohrium=BH); res = a * 2 + b" % (shape,)
+        return cmd
+
+    def test_transposed_add(self, shape):
+        cmd = "R = bh.random.RandomState(42); a = R.random(%s, dtype=np.float64, bohrium=BH); " % (shape,)
+        cmd += "b = R.random(%s, dtype=np.float64, bohrium=BH); res = a.T * 2 + b" % (shape[::-1],)
+        return cmd
+
+    def test_square_transposed_add(self, shape):
+        n = shape[0]
+        cmd = "a = M.arange(%d, dtype=np.int64).reshape(%d, %d); res = a + a.T" % (n * n, n, n)
+        return cmd
@@ -23,8 +23,11 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <fstream>
 #include <string>
 #include <map>
+#include <set>
 #include <iomanip>
 #include <dlfcn.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include <jitk/codegen_util.hpp>
 #include <jitk/compiler.hpp>
 #include <jitk/fuser_cache.hpp>
@@ -44,9 +47,17 @@ namespace bohrium {
 
 EngineOpenMP::EngineOpenMP(component::ComponentVE &comp, jitk::Statistics &stat) :
         EngineCPU(comp, stat), compiler(comp.config.get<string>("compiler_cmd"),
-                                        comp.config.file_dir.string(), verbose) {
+                                        comp.config.file_dir.string(), verbose),
+        kernel_cache(cache_bin_dir, cache_file_max, "openmp", {".so"}),
+        compile_pool(static_cast<size_t>(std::max(comp.config.defaultGet<int64_t>("compile_workers", 0), int64_t{0}))),
+        tiered(comp.config.defaultGet<bool>("tiered_compilation", false)),
+        tier1_compiler(comp.config.defaultGet<string>("tier1_compiler_cmd", compiler.cmd_template),
+                       comp.config.file_dir.string(), verbose),
+        tiered_calls(comp.config.defaultGet<uint64_t>("tiered_calls", 10)),
+        tiered_time(comp.config.defaultGet<double>("tiered_time", 0.01)) {
 
     compilation_hash = util::hash(compiler.cmd_template);
+    tier1_compilation_hash = util::hash(tier1_compiler.cmd_template);
 
     // Initiate cache limits
     const uint64_t sys_mem = bh_main_memory_total();
@@ -56,24 +67,42 @@ EngineOpenMP::EngineOpenMP(component::ComponentVE &comp, jitk::Statistics &stat)
     }
     malloc_cache_limit_in_bytes = static_cast<int64_t>(std::floor(sys_mem * (malloc_cache_limit_in_percent / 100.0)));
     bh_set_malloc_cache_limit(static_cast<uint64_t>(malloc_cache_limit_in_bytes));
+
+    // Initiate the paging of main memory allocations
+    const string huge_pages = comp.config.defaultGet<string>("huge_pages", "none");
+    bh_huge_pages paging;
+    if (huge_pages == "none") {
+        paging = bh_huge_pages::NONE;
+    } else if (huge_pages == "madvise") {
+        paging = bh_huge_pages::MADVISE;
+    } else if (huge_pages == "hugetlb") {
+        paging = bh_huge_pages::HUGETLB;
+    } else {
+        throw std::runtime_error("config: `huge_pages` must be 'none', 'madvise', or 'hugetlb'");
+    }
+    uint64_t prefault_threads = 0;
+    if (comp.config.defaultGet<bool>("prefault_pages", false)) {
+        prefault_threads = comp.config.defaultGet<uint64_t>("prefault_threads", 0);
+        if (prefault_threads == 0) {
+            prefault_threads = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+    }
+    bh_set_main_memory_paging(paging, comp.config.defaultGet<uint64_t>("huge_pages_threshold", 2097152),
+                              prefault_threads, comp.config.defaultGet<uint64_t>("prefault_threshold", 16777216));
+    initNUMA();
 }
 
 EngineOpenMP::~EngineOpenMP() {
-    // Move JIT kernels to the cache dir
-    if (not cache_bin_dir.empty()) {
-        try {
-            for (const auto &kernel: _functions) {
-                const fs::path src = tmp_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
-                if (fs::exists(src)) {
-                    const fs::path dst = cache_bin_dir / jitk::hash_filename(compilation_hash, kernel.first, ".so");
-                    if (not fs::exists(dst)) {
-                        fs::copy_file(src, dst);
-                    }
-                }
-            }
-        } catch (const boost::filesystem::filesystem_error &e) {
-            cout << "Warning: couldn't write JIT kernels to disk to " << cache_bin_dir
-                 << ". " << e.what() << endl;
+    // The placement might call a kernel of this engine
+    bh_set_main_memory_placement(nullptr);
+
+    // Let's wait for unfinished compilations, which might still use the tmp dirs
+    for (const auto &compilation: _pending_compiles) {
+        compilation.second.wait();
+    }
+    for (const auto &kernel: _tier1_kernels) {
+        if (kernel.second.compilation.valid()) {
+            kernel.second.compilation.wait();
         }
     }
 
@@ -82,10 +111,6 @@ EngineOpenMP::~EngineOpenMP() {
         fs::remove_all(tmp_src_dir);
     }
 
-    if (cache_file_max != -1 and not cache_bin_dir.empty()) {
-        util::remove_old_files(cache_bin_dir, cache_file_max);
-    }
-
     // If this cleanup is enabled, the application segfaults
     // on destruction of the EngineOpenMP class.
     //
@@ -110,6 +135,173 @@ EngineOpenMP::~EngineOpenMP() {
     // }
 }
 
+void EngineOpenMP::compileFunction(const fs::path &binfile, const string &source, uint64_t hash,
+                                   const string &compile_cmd, bool tier1) const {
+    const jitk::Compiler &selected_compiler = tier1 ? tier1_compiler : compiler;
+
+    // Write the source file and compile it (reading from disk)
+    // NB: this is a nice debug option, but will hurt performance
+    if (verbose) {
+        std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
+        fs::path srcfile = jitk::write_source2file(source, tmp_src_dir, source_filename, true);
+        if (compile_cmd.empty()) {
+            selected_compiler.compile(binfile, srcfile);
+        } else {
+            compiler.compile(binfile, srcfile, compile_cmd);
+        }
+    } else {
+        // Pipe the source directly into the compiler thus no source file is written
+        if (compile_cmd.empty()) {
+            selected_compiler.compile(binfile, source);
+        } else {
+            compiler.compile(binfile, source, compile_cmd);
+        }
+    }
+}
+
+fs::path EngineOpenMP::tmpBinfile(uint64_t hash, bool tier1) const {
+    const uint64_t hash_of_compilation = tier1 ? tier1_compilation_hash : compilation_hash;
+    return tmp_bin_dir / jitk::hash_filename(hash_of_compilation, hash, ".so");
+}
+
+fs::path EngineOpenMP::buildFunction(const string &source, uint64_t hash, const string &compile_cmd,
+                                     bool tier1) const {
+    const fs::path binfile = tmpBinfile(hash, tier1);
+    if (tier1) { // Tier-1 kernels are never cached
+        compileFunction(binfile, source, hash, compile_cmd, true);
+        return binfile;
+    }
+    // While we hold the lock, other processes wait for us to publish the kernel instead of compiling it as well
+    const string filename = binfile.filename().string();
+    const auto lock = kernel_cache.lockCompilation(filename);
+    if (not verbose) {
+        const fs::path cached = kernel_cache.lookup(filename);
+        if (not cached.empty()) {
+            return cached;
+        }
+    }
+    compileFunction(binfile, source, hash, compile_cmd, false);
+    kernel_cache.publish(binfile, filename);
+    return binfile;
+}
+
+void EngineOpenMP::prepareFunctions(const vector<pair<string, uint64_t> > &source_list) {
+    if (compile_pool.size() < 2) {
+        return;
+    }
+
+    // Let's find the kernels that are neither loaded, in progress, nor in the cache dir
+    vector<pair<const string *, uint64_t> > missing;
+    set<uint64_t> seen;
+    for (const auto &source: source_list) {
+        if (source.first.empty()) {
+            continue;
+        }
+        const uint64_t hash = util::hash(source.first);
+        if (_functions.find(hash) != _functions.end() or _pending_compiles.find(hash) != _pending_compiles.end()
+            or not seen.insert(hash).second) {
+            continue;
+        }
+        if (not verbose and kernel_cache.contains(jitk::hash_filename(compilation_hash, hash, ".so"))) {
+            continue;
+        }
+        missing.emplace_back(&source.first, hash);
+    }
+
+    // A single kernel gains nothing from the workers, we let `getFunction()` compile it
+    if (missing.size() < 2) {
+        return;
+    }
+    const bool tier1 = useTier1("");
+    for (const auto &kernel: missing) {
+        const string source = *kernel.first;
+        const uint64_t hash = kernel.second;
+        _pending_compiles[hash] = compile_pool.submit([this, source, hash, tier1]() {
+            return buildFunction(source, hash, "", tier1);
+        });
+    }
+}
+
+namespace {
+// Return the NUMA nodes of the machine and the list of their CPUs (empty when not available)
+map<int, string> detect_numa_nodes() {
+    map<int, string> ret;
+    const fs::path node_dir("/sys/devices/system/node");
+    boost::system::error_code ec;
+    for (fs::directory_iterator it(node_dir, ec), end; not ec and it != end; it.increment(ec)) {
+        const string name = it->path().filename().string();
+        if (name.compare(0, 4, "node") != 0 or name.size() == 4 or
+            name.find_first_not_of("0123456789", 4) != string::npos) {
+            continue;
+        }
+        std::ifstream cpulist((it->path() / "cpulist").string());
+        string cpus;
+        if (std::getline(cpulist, cpus) and not cpus.empty()) {
+            ret[std::stoi(name.substr(4))] = cpus;
+        }
+    }
+    return ret;
+}
+}
+
+void EngineOpenMP::initNUMA() {
+    numa_placement = comp.config.defaultGet<string>("numa_placement", "first_touch");
+    if (numa_placement != "none" and numa_placement != "first_touch" and numa_placement != "interleave") {
+        throw std::runtime_error("config: `numa_placement` must be 'none', 'first_touch', or 'interleave'");
+    }
+    const string binding = comp.config.defaultGet<string>("numa_thread_binding", "spread");
+    if (binding != "none" and binding != "close" and binding != "spread") {
+        throw std::runtime_error("config: `numa_thread_binding` must be 'none', 'close', or 'spread'");
+    }
+    numa_nodes = detect_numa_nodes();
+    if (numa_nodes.size() < 2 or not comp.config.defaultGet<bool>("compiler_openmp", false)) {
+        numa_placement = "none"; // All threads share the memory of a single node
+        return;
+    }
+
+    // The OpenMP runtime reads the binding when the first kernel loads it. The binding of the environment takes
+    // precedence, which is also the case when another library loaded the runtime already.
+    if (binding != "none") {
+        setenv("OMP_PROC_BIND", binding.c_str(), 0);
+        setenv("OMP_PLACES", "cores", 0);
+    }
+
+    if (numa_placement == "first_touch") {
+        // Writing the pages in the parallel loop of the kernels places the pages of each thread's static chunk on the
+        // node of the thread. The loop runs on the thread pool of the kernels thus the threads are bound alike.
+        const string source = "#include <stdint.h>\n"
+                              "void first_touch(char *mem, uint64_t nbytes, uint64_t page_size) {\n"
+                              "    const int64_t npages = (nbytes + page_size - 1) / page_size;\n"
+                              "    #pragma omp parallel for\n"
+                              "    for (int64_t i = 0; i < npages; ++i) {\n"
+                              "        ((volatile char *) mem)[i * page_size] = 0;\n"
+                              "    }\n"
+                              "}\n";
+        typedef void (*FirstTouchFunction)(char *, uint64_t, uint64_t);
+        const auto first_touch = reinterpret_cast<FirstTouchFunction>(getFunction(source, "first_touch"));
+        const auto page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        bh_set_main_memory_placement([first_touch, page_size](void *mem, uint64_t nbytes) {
+            first_touch(static_cast<char *>(mem), nbytes, page_size);
+        });
+    } else if (numa_placement == "interleave") {
+#ifdef SYS_mbind
+        // The pages are spread round-robin over the nodes as they are faulted in (MPOL_INTERLEAVE of <numaif.h>)
+        const int mpol_interleave = 3;
+        const int bits = std::numeric_limits<unsigned long>::digits;
+        std::vector<unsigned long> node_mask(static_cast<size_t>(numa_nodes.rbegin()->first / bits + 1), 0);
+        for (const auto &node: numa_nodes) {
+            node_mask[node.first / bits] |= 1ul << (node.first % bits);
+        }
+        bh_set_main_memory_placement([node_mask](void *mem, uint64_t nbytes) {
+            // The kernel ignores the last bit of the mask thus the number of bits is one more than the mask size
+            syscall(SYS_mbind, mem, nbytes, mpol_interleave, node_mask.data(), node_mask.size() * bits + 1, 0);
+        });
+#else
+        numa_placement = "none";
+#endif
+    }
+}
+
 KernelFunction EngineOpenMP::getFunction(const string &source, const string &func_name, const string &compile_cmd) {
     uint64_t hash = util::hash(source);
     ++stat.kernel_cache_lookups;
@@ -119,40 +311,57 @@ KernelFunction EngineOpenMP::getFunction(const string &source, const string &fun
         return _functions.at(hash);
     }
 
-    fs::path binfile = cache_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
+    const bool tier1 = useTier1(compile_cmd);
+    const string filename = jitk::hash_filename(compilation_hash, hash, ".so");
+    fs::path binfile;
 
-    // If the binary file of the kernel doesn't exist we create it
-    if (verbose or cache_bin_dir.empty() or not fs::exists(binfile)) {
+    auto pending = _pending_compiles.find(hash);
+    if (pending != _pending_compiles.end()) {
+        // The compile workers are producing the binary file already (see `prepareFunctions()`)
         ++stat.kernel_cache_misses;
+        const shared_future<fs::path> compilation = pending->second;
+        _pending_compiles.erase(pending);
+        binfile = compilation.get(); // NB: rethrows compile errors
+    } else {
+        if (not verbose) {
+            binfile = kernel_cache.lookup(filename);
+        }
+        if (binfile.empty()) {
+            // If the binary file of the kernel doesn't exist we build it
+            ++stat.kernel_cache_misses;
+            binfile = buildFunction(source, hash, compile_cmd, tier1);
+        }
+    }
+    if (tier1 and binfile == tmpBinfile(hash, true)) {
+        _tier1_kernels[hash] = TieredKernel{source, func_name, {}};
+    }
 
-        // We create the binary file in the tmp dir
-        binfile = tmp_bin_dir / jitk::hash_filename(compilation_hash, hash, ".so");
-
-        // Write the source file and compile it (reading from disk)
-        // NB: this is a nice debug option, but will hurt performance
-        if (verbose) {
-            std::string source_filename = jitk::hash_filename(compilation_hash, hash, ".c");
-            fs::path srcfile = jitk::write_source2file(source, tmp_src_dir, source_filename, true);
-            if (compile_cmd.empty()) {
-                compiler.compile(binfile, srcfile);
-            } else {
-                compiler.compile(binfile, srcfile, compile_cmd);
-            }
-        } else {
-            // Pipe the source directly into the compiler thus no source file is written
-            if (compile_cmd.empty()) {
-                compiler.compile(binfile, source);
-            } else {
-                compiler.compile(binfile, source, compile_cmd);
-            }
+    // Load the object file into executable memory
+    void *func;
+    try {
+        func = loadLibrary(binfile, func_name);
+    } catch (const runtime_error &) {
+        if (binfile == tmpBinfile(hash, tier1)) {
+            throw;
+        }
+        // Another process evicted the kernel from the cache after our lookup thus we build it again
+        ++stat.kernel_cache_misses;
+        binfile = tmpBinfile(hash, tier1);
+        compileFunction(binfile, source, hash, compile_cmd, tier1);
+        if (not tier1) {
+            kernel_cache.publish(binfile, filename);
         }
+        func = loadLibrary(binfile, func_name);
     }
+    *(void **) (&_functions[hash]) = func;
+    return _functions.at(hash);
+}
 
+void *EngineOpenMP::loadLibrary(const fs::path &binfile, const string &func_name) {
     // Load the shared library
     void *lib_handle = dlopen(binfile.string().c_str(), RTLD_NOW);
     if (lib_handle == nullptr) {
-        cerr << "Cannot load library: " << dlerror() << endl;
-        throw runtime_error("VE-OPENMP: Cannot load library");
+        throw runtime_error(string("VE-OPENMP: Cannot load library: ") + dlerror());
     }
     _lib_handles.push_back(lib_handle);
 
@@ -160,20 +369,64 @@ KernelFunction EngineOpenMP::getFunction(const string &source, const string &fun
     // The (clumsy) cast conforms with the ISO C standard and will
     // avoid any compiler warnings.
     dlerror(); // Reset errors
-    *(void **) (&_functions[hash]) = dlsym(lib_handle, func_name.c_str());
+    void *func = dlsym(lib_handle, func_name.c_str());
     const char *dlsym_error = dlerror();
     if (dlsym_error != nullptr) {
         cerr << "Cannot load function launcher(): " << dlsym_error << endl;
         throw runtime_error("VE-OPENMP: Cannot load function launcher()");
     }
-    return _functions.at(hash);
+    return func;
 }
 
+KernelFunction EngineOpenMP::updateFunction(uint64_t source_hash, const jitk::KernelStats &kernel_stats,
+                                            KernelFunction func) {
+    if (not tiered) {
+        return func;
+    }
+    auto tier1_kernel = _tier1_kernels.find(source_hash);
+    if (tier1_kernel == _tier1_kernels.end()) {
+        // NB: the kernel might have been swapped through another plan that shares the kernel
+        auto it = _functions.find(source_hash);
+        return it != _functions.end() ? it->second : func;
+    }
+    TieredKernel &kernel = tier1_kernel->second;
+
+    // When the kernel becomes hot, we recompile it with full optimization in the background
+    if (not kernel.compilation.valid()) {
+        if (kernel_stats.num_calls >= tiered_calls or kernel_stats.total_time.count() >= tiered_time) {
+            const string source = kernel.source;
+            kernel.compilation = compile_pool.submit([this, source, source_hash]() {
+                return buildFunction(source, source_hash, "", false);
+            });
+        }
+        return func;
+    }
+    if (kernel.compilation.wait_for(chrono::seconds(0)) != future_status::ready) {
+        return func;
+    }
+
+    // The optimized kernel is ready, let's swap it in
+    fs::path binfile;
+    try {
+        binfile = kernel.compilation.get();
+    } catch (const std::exception &e) {
+        // The tier-1 build is still correct thus a failed recompilation isn't fatal
+        if (verbose) {
+            cout << "Warning: tiered recompilation failed, keeping the tier-1 kernel. " << e.what() << endl;
+        }
+        _tier1_kernels.erase(tier1_kernel);
+        return func;
+    }
+    void *optimized = loadLibrary(binfile, kernel.func_name);
+    *(void **) (&_functions[source_hash]) = optimized;
+    _tier1_kernels.erase(tier1_kernel);
+    return _functions.at(source_hash);
+}
 
-void EngineOpenMP::execute(const jitk::SymbolTable &symbols,
-                           const std::string &source,
-                           uint64_t codegen_hash,
-                           const std::vector<const bh_instruction *> &constants) {
+KernelFunction EngineOpenMP::execute(const jitk::SymbolTable &symbols,
+                                     const std::string &source,
+                                     uint64_t codegen_hash,
+                                     const std::vector<const bh_instruction *> &constants) {
     // Notice, we use a "pure" hash of `source` to make sure that the `source_filename` always
     // corresponds to `source` even if `codegen_hash` is buggy.
     uint64_t hash = util::hash(source);
@@ -198,11 +451,12 @@ void EngineOpenMP::execute(const jitk::SymbolTable &symbols,
 
     // Create a 'data_list' of data pointers
     vector<void *> data_list;
-    data_list.reserve(symbols.getParams().size());
+    data_list.reserve(symbols.getParams().size() + 1);
     for (bh_base *base: symbols.getParams()) {
         assert(base->getDataPtr() != nullptr);
         data_list.push_back(base->getDataPtr());
     }
+    data_list.push_back(scratch_arena.interface());
 
     // And the offset-and-strides
     vector<uint64_t> offset_and_strides;
@@ -226,10 +480,12 @@ void EngineOpenMP::execute(const jitk::SymbolTable &symbols,
     auto start_exec = chrono::steady_clock::now();
     // Call the launcher function, which will execute the kernel
     func(&data_list[0], &offset_and_strides[0], &constant_arg[0]);
+    scratch_arena.reset();
     auto texec = chrono::steady_clock::now() - start_exec;
     stat.time_exec += texec;
-    stat.time_per_kernel[source_filename].register_exec_time(texec);
-
+    jitk::KernelStats &kernel_stats = stat.time_per_kernel[source_filename];
+    kernel_stats.register_exec_time(texec);
+    return updateFunction(hash, kernel_stats, func);
 }
 
 // Writes the OpenMP specific for-loop header
@@ -251,6 +507,11 @@ void EngineOpenMP::loopHeadWriter(const jitk::SymbolTable &symbols,
         t << "i" << block.rank;
         itername = t.str();
     }
+    if (scope.isBlockedLoop(block.rank)) { // The loop iterates the current block of its axis
+        out << "for(uint64_t " << itername << " = " << itername << "_begin; ";
+        out << itername << " < " << itername << "_end; ++" << itername << ") {\n";
+        return;
+    }
     out << "for(uint64_t " << itername << " = 0; ";
     out << itername << " < " << block.size << "; ++" << itername << ") {\n";
 }
@@ -275,12 +536,19 @@ void EngineOpenMP::writeHeader(const jitk::SymbolTable &symbols,
     stringstream ss;
     // "OpenMP for" goes to the outermost loop
     if (block.rank == 0 and openmp_compatible(block)) {
-        ss << " parallel for";
+        // Reductions into per-thread partial results are within a parallel region opened by `loopPrologueWriter()`
+        bool in_parallel_region = false;
+        for (const jitk::InstrPtr &instr: ordered_block_sweeps) {
+            in_parallel_region = in_parallel_region or scope.isOpenmpPartial(instr);
+        }
+        ss << (in_parallel_region ? " for" : " parallel for");
         // Since we are doing parallel for, we should either do OpenMP reductions or protect the sweep instructions
         for (const jitk::InstrPtr &instr: ordered_block_sweeps) {
             assert(instr->operand.size() == 3);
             const bh_view &view = instr->operand[0];
-            if (openmp_reduce_compatible(instr->opcode) and (scope.isScalarReplaced(view) or scope.isTmp(view.base))) {
+            if (scope.isOpenmpPartial(instr)) {
+                continue;
+            } else if (openmp_reduce_compatible(instr->opcode) and (scope.isScalarReplaced(view) or scope.isTmp(view.base))) {
                 openmp_reductions.push_back(instr);
             } else if (openmp_atomic_compatible(instr->opcode)) {
                 scope.insertOpenmpAtomic(instr);
@@ -291,7 +559,8 @@ void EngineOpenMP::writeHeader(const jitk::SymbolTable &symbols,
     }
 
     // "OpenMP SIMD" goes to the innermost loop (which might also be the outermost loop)
-    if (enable_simd and block.isInnermost() and simd_compatible(block, scope)) {
+    if (enable_simd and block.isInnermost() and not scope.isSequential() and
+        simd_compatible(block, scope)) {
         ss << " simd";
         if (block.rank > 0) { // NB: avoid multiple reduction declarations
             for (const jitk::InstrPtr &instr: ordered_block_sweeps) {
@@ -314,6 +583,294 @@ void EngineOpenMP::writeHeader(const jitk::SymbolTable &symbols,
     }
 }
 
+bool EngineOpenMP::loopWriter(const jitk::SymbolTable &symbols,
+                              jitk::Scope &scope,
+                              const jitk::LoopB &block,
+                              const vector<uint64_t> &thread_stack,
+                              std::stringstream &out) {
+    if (not comp.config.defaultGet<bool>("compiler_openmp", false)) {
+        return false;
+    }
+    if (comp.config.defaultGet<bool>("openmp_parallel_scan", false) and
+        block.size >= comp.config.defaultGet<int64_t>("openmp_scan_threshold", 100000) and
+        openmp_scan_compatible(block, scope)) {
+        writeScanLoop(symbols, scope, block, thread_stack, out);
+        return true;
+    }
+    const int64_t block_size = comp.config.defaultGet<int64_t>("openmp_column_block", 0);
+    if (block_size > 0 and openmp_column_reduction_compatible(block, scope, block_size)) {
+        writeColumnReductionLoop(symbols, scope, block, block_size, thread_stack, out);
+        return true;
+    }
+    return false;
+}
+
+// Long accumulations are written as a blocked parallel scan in three phases. First, each thread scans its chunk of the
+// loop starting from the identity. Then, each thread finds the carry of its chunk by combining the totals of the
+// previous chunks. Finally, each thread (but the first) recomputes its chunk starting from the carry, which also
+// recomputes the fused instructions that read the accumulated arrays.
+void EngineOpenMP::writeScanLoop(const jitk::SymbolTable &symbols,
+                                 jitk::Scope &scope,
+                                 const jitk::LoopB &block,
+                                 const vector<uint64_t> &thread_stack,
+                                 std::stringstream &out) {
+    const std::vector<jitk::InstrPtr> scans = order_sweep_set(block._sweeps, symbols);
+    const string itername = "i" + std::to_string(block.rank);
+    jitk::Scope scan_scope(symbols, &scope);
+
+    util::spaces(out, 4);
+    out << "{ // Parallel scan of the accumulations\n";
+    util::spaces(out, 8);
+    out << "const int nthreads = omp_get_max_threads();\n";
+    for (const jitk::InstrPtr &instr: scans) {
+        const bh_base *base = instr->operand[0].base;
+        util::spaces(out, 8);
+        out << writeType(base->dtype()) << " * __restrict__ a" << symbols.baseID(base) << "_totals = "
+            << "scratch_alloc(nthreads * sizeof(" << writeType(base->dtype()) << "));\n";
+        scan_scope.insertScanCarry(base);
+    }
+    util::spaces(out, 8);
+    out << "#pragma omp parallel num_threads(nthreads)\n";
+    util::spaces(out, 8);
+    out << "{\n";
+    util::spaces(out, 12);
+    out << "const int tid = omp_get_thread_num();\n";
+    util::spaces(out, 12);
+    out << "const int nparts = omp_get_num_threads();\n";
+    util::spaces(out, 12);
+    out << "const uint64_t " << itername << "_begin = " << block.size << "ul * tid / nparts;\n";
+    util::spaces(out, 12);
+    out << "const uint64_t " << itername << "_end = " << block.size << "ul * (tid + 1) / nparts;\n";
+
+    // Phase one: scan the chunk and save its total
+    util::spaces(out, 12);
+    out << "{ // Scan the chunk\n";
+    for (const jitk::InstrPtr &instr: scans) {
+        const bh_view &view = instr->operand[0];
+        util::spaces(out, 16);
+        out << writeType(view.base->dtype()) << " " << scan_scope.getName(view) << "_carry = ";
+        sweep_identity(instr->opcode, view.base->dtype()).pprint(out, false);
+        out << ";\n";
+    }
+    util::spaces(out, 16);
+    out << "for(uint64_t " << itername << " = " << itername << "_begin; " << itername << " < " << itername
+        << "_end; ++" << itername << ") {\n";
+    writeBlock(symbols, &scan_scope, block, thread_stack, false, out);
+    util::spaces(out, 16);
+    out << "}\n";
+    for (const jitk::InstrPtr &instr: scans) {
+        const bh_view &view = instr->operand[0];
+        util::spaces(out, 16);
+        out << "if (" << itername << "_end > " << itername << "_begin) {\n";
+        util::spaces(out, 20);
+        out << "const uint64_t " << itername << " = " << itername << "_end - 1;\n";
+        util::spaces(out, 20);
+        out << scan_scope.getName(view) << "_totals[tid] = " << scan_scope.getName(view);
+        write_array_subscription(scan_scope, view, out, false);
+        out << ";\n";
+        util::spaces(out, 16);
+        out << "} else {\n";
+        util::spaces(out, 20);
+        out << scan_scope.getName(view) << "_totals[tid] = ";
+        sweep_identity(instr->opcode, view.base->dtype()).pprint(out, false);
+        out << ";\n";
+        util::spaces(out, 16);
+        out << "}\n";
+    }
+    util::spaces(out, 12);
+    out << "}\n";
+    util::spaces(out, 12);
+    out << "#pragma omp barrier\n";
+
+    // Phase two and three: combine the totals of the previous chunks into the carry and recompute the chunk
+    util::spaces(out, 12);
+    out << "if (tid > 0) { // Recompute the chunk from the carry of the previous chunks\n";
+    for (const jitk::InstrPtr &instr: scans) {
+        const string name = scan_scope.getName(instr->operand[0]);
+        util::spaces(out, 16);
+        out << writeType(instr->operand[0].base->dtype()) << " " << name << "_carry = " << name << "_totals[0];\n";
+        util::spaces(out, 16);
+        out << "for(int t = 1; t < tid; ++t) {\n";
+        util::spaces(out, 20);
+        write_operation(*instr, {name + "_carry", name + "_carry", name + "_totals[t]"}, out, false);
+        util::spaces(out, 16);
+        out << "}\n";
+    }
+    util::spaces(out, 16);
+    out << "for(uint64_t " << itername << " = " << itername << "_begin; " << itername << " < " << itername
+        << "_end; ++" << itername << ") {\n";
+    writeBlock(symbols, &scan_scope, block, thread_stack, false, out);
+    util::spaces(out, 16);
+    out << "}\n";
+    util::spaces(out, 12);
+    out << "}\n";
+    util::spaces(out, 8);
+    out << "}\n";
+    for (auto it = scans.rbegin(); it != scans.rend(); ++it) {
+        util::spaces(out, 8);
+        out << "scratch_free(a" << symbols.baseID((*it)->operand[0].base) << "_totals);\n";
+    }
+    util::spaces(out, 4);
+    out << "}\n";
+}
+
+// Reductions over the outer axis of a matrix (e.g. column sums of a C-ordered matrix) are written as row-wise
+// accumulations: the loop over the reduced axis goes inside a parallel loop over blocks of the output axis. Thus each
+// thread accumulates contiguous rows into its own block of the output, which stays in cache.
+void EngineOpenMP::writeColumnReductionLoop(const jitk::SymbolTable &symbols,
+                                            jitk::Scope &scope,
+                                            const jitk::LoopB &block,
+                                            int64_t block_size,
+                                            const vector<uint64_t> &thread_stack,
+                                            std::stringstream &out) {
+    const int64_t output_size = block._block_list.front().getLoop().size;
+    const string itername = "i" + std::to_string(block.rank + 1);
+    jitk::Scope blocked_scope(symbols, &scope);
+    blocked_scope.setBlockedLoop(block.rank + 1);
+
+    util::spaces(out, 4);
+    out << "{ // Column-wise reductions blocked along the output axis\n";
+    util::spaces(out, 8);
+    out << "#pragma omp parallel for\n";
+    util::spaces(out, 8);
+    out << "for(uint64_t " << itername << "_block = 0; " << itername << "_block < " << output_size << "; "
+        << itername << "_block += " << block_size << ") {\n";
+    util::spaces(out, 12);
+    out << "const uint64_t " << itername << "_begin = " << itername << "_block;\n";
+    util::spaces(out, 12);
+    out << "const uint64_t " << itername << "_end = " << itername << "_block + " << block_size << " < "
+        << output_size << " ? " << itername << "_block + " << block_size << " : " << output_size << ";\n";
+    util::spaces(out, 12);
+    out << "for(uint64_t i" << block.rank << " = 0; i" << block.rank << " < " << block.size << "; ++i"
+        << block.rank << ") {\n";
+    writeBlock(symbols, &blocked_scope, block, thread_stack, false, out);
+    util::spaces(out, 12);
+    out << "}\n";
+    util::spaces(out, 8);
+    out << "}\n";
+    util::spaces(out, 4);
+    out << "}\n";
+}
+
+namespace {
+// Return the number of threads of the parallel regions of the kernels (i.e. `omp_get_max_threads()`)
+uint64_t openmp_max_threads() {
+    const char *env = getenv("OMP_NUM_THREADS");
+    if (env != nullptr and atoi(env) > 0) {
+        return static_cast<uint64_t>(atoi(env));
+    }
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+}
+
+// Reductions into arrays in the parallel loop write to per-thread partial results instead of being guarded by OpenMP
+// atomic or critical. The partial results of a thread shadow the output array within the parallel region thus the
+// loop body is written as usual. Finally, the threads combine the partial results in parallel.
+// The partial results of all threads must fit in the scratch arena, larger reductions keep atomic or critical.
+void EngineOpenMP::loopPrologueWriter(const jitk::SymbolTable &symbols,
+                                      jitk::Scope &scope,
+                                      const jitk::LoopB &block,
+                                      std::stringstream &out) {
+    if (block.rank != 0 or block.size <= 1 or not comp.config.defaultGet<bool>("compiler_openmp", false) or
+        not comp.config.defaultGet<bool>("openmp_partial_reductions", false) or not openmp_compatible(block)) {
+        return;
+    }
+    const uint64_t nthreads = openmp_max_threads();
+    uint64_t nbytes_left = comp.config.defaultGet<uint64_t>("scratch_arena_limit", 268435456);
+    std::vector<jitk::InstrPtr> partials;
+    for (const jitk::InstrPtr &instr: order_sweep_set(block._sweeps, symbols)) {
+        const bh_view &view = instr->operand[0];
+        if (not(openmp_reduce_compatible(instr->opcode) and (scope.isScalarReplaced(view) or scope.isTmp(view.base)))
+            and openmp_partial_compatible(instr, block)) {
+            const uint64_t nbytes = nthreads * static_cast<uint64_t>(view.base->nbytes());
+            if (nbytes <= nbytes_left) {
+                nbytes_left -= nbytes;
+                partials.push_back(instr);
+            }
+        }
+    }
+    if (partials.empty()) {
+        return;
+    }
+
+    util::spaces(out, 4);
+    out << "{ // Per-thread partial results of the reductions into arrays\n";
+    util::spaces(out, 8);
+    out << "const int nthreads = omp_get_max_threads();\n";
+    for (const jitk::InstrPtr &instr: partials) {
+        const bh_base *base = instr->operand[0].base;
+        util::spaces(out, 8);
+        out << writeType(base->dtype()) << " * __restrict__ a" << symbols.baseID(base) << "_partials = "
+            << "scratch_alloc(nthreads * " << base->nbytes() << "ul);\n";
+        scope.insertOpenmpPartial(instr);
+    }
+    util::spaces(out, 8);
+    out << "#pragma omp parallel num_threads(nthreads)\n";
+    util::spaces(out, 8);
+    out << "{\n";
+    util::spaces(out, 8);
+    out << "{\n";
+    for (const jitk::InstrPtr &instr: partials) {
+        const bh_base *base = instr->operand[0].base;
+        const size_t id = symbols.baseID(base);
+        util::spaces(out, 8);
+        out << writeType(base->dtype()) << " * __restrict__ a" << id << " = a" << id
+            << "_partials + omp_get_thread_num() * " << base->nelem() << "ul;\n";
+        util::spaces(out, 8);
+        out << "for(uint64_t i = 0; i < " << base->nelem() << "; ++i) { a" << id << "[i] = ";
+        sweep_identity(instr->opcode, base->dtype()).pprint(out, false);
+        out << "; }\n";
+    }
+}
+
+void EngineOpenMP::loopEpilogueWriter(const jitk::SymbolTable &symbols,
+                                      jitk::Scope &scope,
+                                      const jitk::LoopB &block,
+                                      std::stringstream &out) {
+    std::vector<jitk::InstrPtr> partials;
+    for (const jitk::InstrPtr &instr: order_sweep_set(block._sweeps, symbols)) {
+        if (scope.isOpenmpPartial(instr)) {
+            partials.push_back(instr);
+        }
+    }
+    if (partials.empty()) {
+        return;
+    }
+
+    util::spaces(out, 8);
+    out << "}\n";
+    util::spaces(out, 8);
+    out << "const int nparts = omp_get_num_threads();\n";
+    for (const jitk::InstrPtr &instr: partials) {
+        const bh_base *base = instr->operand[0].base;
+        const size_t id = symbols.baseID(base);
+        stringstream output, partial;
+        output << "a" << id << "[i]";
+        partial << "a" << id << "_partials[t * " << base->nelem() << "ul + i]";
+        util::spaces(out, 8);
+        out << "#pragma omp for\n";
+        util::spaces(out, 8);
+        out << "for(uint64_t i = 0; i < " << base->nelem() << "; ++i) {\n";
+        util::spaces(out, 12);
+        out << "for(int t = 0; t < nparts; ++t) {\n";
+        util::spaces(out, 16);
+        write_operation(*instr, {output.str(), partial.str()}, out, false);
+        util::spaces(out, 12);
+        out << "}\n";
+        util::spaces(out, 8);
+        out << "}\n";
+    }
+    util::spaces(out, 8);
+    out << "}\n";
+    for (auto it = partials.rbegin(); it != partials.rend(); ++it) {
+        util::spaces(out, 8);
+        out << "scratch_free(a" << symbols.baseID((*it)->operand[0].base) << "_partials);\n";
+        scope.eraseOpenmpPartial(*it);
+    }
+    util::spaces(out, 4);
+    out << "}\n";
+}
+
 void EngineOpenMP::writeKernel(const LoopB &kernel,
                                const jitk::SymbolTable &symbols,
                                const std::vector<bh_base *> &kernel_temps,
@@ -329,11 +886,24 @@ void EngineOpenMP::writeKernel(const LoopB &kernel,
     ss << "#include <complex.h>\n";
     ss << "#include <tgmath.h>\n";
     ss << "#include <math.h>\n";
+    if (comp.config.defaultGet<bool>("compiler_openmp", false)) {
+        ss << "#include <omp.h>\n";
+    }
     if (symbols.useRandom()) { // Write the random function
         ss << "#include <kernel_dependencies/random123_openmp.h>\n";
     }
     writeUnionType(ss); // We always need to declare the union of all constant data types
     ss << "\n";
+    // The scratch memory of the engine (see `jitk::ScratchInterface`), which is set by the launcher
+    ss << "struct bh_scratch {\n";
+    ss << "    void *arena;\n";
+    ss << "    void *(*alloc)(void *arena, uint64_t nbytes);\n";
+    ss << "    void (*free)(void *arena, void *mem);\n";
+    ss << "};\n";
+    ss << "static struct bh_scratch *bh_scratch;\n";
+    ss << "static void *scratch_alloc(uint64_t nbytes) { return bh_scratch->alloc(bh_scratch->arena, nbytes); }\n";
+    ss << "static void scratch_free(void *mem) { bh_scratch->free(bh_scratch->arena, mem); }\n";
+    ss << "\n";
 
     // Write the header of the execute function
     ss << "void execute_" << codegen_hash;
@@ -344,18 +914,18 @@ void EngineOpenMP::writeKernel(const LoopB &kernel,
     // Write allocations of the kernel temporaries
     for (const bh_base *b: kernel_temps) {
         util::spaces(ss, 4);
-        ss << writeType(b->dtype()) << " * __restrict__ a" << symbols.baseID(b) << " = malloc(" << b->nbytes()
-           << ");\n";
+        ss << writeType(b->dtype()) << " * __restrict__ a" << symbols.baseID(b) << " = scratch_alloc("
+           << b->nbytes() << ");\n";
     }
     ss << "\n";
 
     writeBlock(symbols, nullptr, kernel, {}, false, ss);
 
-    // Write frees of the kernel temporaries
+    // Write frees of the kernel temporaries in reverse order of the allocations
     ss << "\n";
-    for (const bh_base *b: kernel_temps) {
+    for (auto it = kernel_temps.rbegin(); it != kernel_temps.rend(); ++it) {
         util::spaces(ss, 4);
-        ss << "free(" << "a" << symbols.baseID(b) << ");\n";
+        ss << "scratch_free(a" << symbols.baseID(*it) << ");\n";
     }
     ss << "}\n\n";
 
@@ -370,6 +940,8 @@ void EngineOpenMP::writeKernel(const LoopB &kernel,
             ss << writeType(b->dtype()) << " *a" << symbols.baseID(b);
             ss << " = data_list[" << i << "];\n";
         }
+        util::spaces(ss, 4);
+        ss << "bh_scratch = data_list[" << symbols.getParams().size() << "];\n";
 
         util::spaces(ss, 4);
         ss << "execute_" << codegen_hash << "(";
@@ -416,6 +988,17 @@ std::string EngineOpenMP::info() const {
     ss << "  Hardware threads: " << std::thread::hardware_concurrency() << "\n";
     ss << "  Malloc cache limit: " << malloc_cache_limit_in_bytes / 1024 / 1024
        << " MB (" << malloc_cache_limit_in_percent << "%)\n";
+    ss << "  Huge pages: " << comp.config.defaultGet<string>("huge_pages", "none") << " (allocations of at least "
+       << comp.config.defaultGet<uint64_t>("huge_pages_threshold", 2097152) / 1024 << " kB)\n";
+    ss << "  NUMA nodes: " << numa_nodes.size();
+    for (const auto &node: numa_nodes) {
+        ss << (node.first == numa_nodes.begin()->first ? " (" : ", ") << "node" << node.first << ": " << node.second;
+    }
+    ss << (numa_nodes.empty() ? "\n" : ")\n");
+    const char *proc_bind = getenv("OMP_PROC_BIND");
+    ss << "  NUMA placement: " << numa_placement << " (thread binding: " << (proc_bind ? proc_bind : "none")
+       << ")\n";
+    ss << "  Pre-fault pages: " << comp.config.defaultGet<bool>("prefault_pages", false) << "\n";
     ss << "  Cache dir: " << comp.config.defaultGet<string>("cache_dir", "") << "\n";
     ss << "  Temp dir: " << jitk::get_tmp_path(comp.config) << "\n";
 
@@ -424,9 +1007,23 @@ std::string EngineOpenMP::info() const {
     ss << "    OpenMP+SIMD: " << comp.config.defaultGet<bool>("compiler_openmp_simd", false) << "\n";
     ss << "    Index-as-var: " << comp.config.defaultGet<bool>("index_as_var", true) << "\n";
     ss << "    Strides-as-var: " << comp.config.defaultGet<bool>("strides_as_var", true) << "\n";
+    ss << "    Index strength reduction: " << comp.config.defaultGet<bool>("index_strength_reduction", false)
+       << "\n";
+    ss << "    Column reduction block: " << comp.config.defaultGet<int64_t>("openmp_column_block", 0) << "\n";
+    ss << "    Parallel scan: " << comp.config.defaultGet<bool>("openmp_parallel_scan", false) << "\n";
+    ss << "    Partial reductions: " << comp.config.defaultGet<bool>("openmp_partial_reductions", false) << "\n";
+    ss << "    Reduction accumulators: " << comp.config.defaultGet<int>("reduction_accumulators", 0) << "\n";
+    ss << "    Stencil register reuse: " << comp.config.defaultGet<bool>("stencil_register_reuse", false) << "\n";
+    ss << "    Unit-stride fast path: " << comp.config.defaultGet<bool>("unit_stride_fastpath", false) << "\n";
     ss << "    Const-as-var: " << comp.config.defaultGet<bool>("const_as_var", true) << "\n";
+    ss << "    Compile workers: " << compile_pool.size() << "\n";
+    ss << "    Tiered compilation: " << useTier1("") << "\n";
+    ss << "    Plan cache: " << use_plan_cache << " (max " << plan_cache.maxPlans() << " plans)\n";
 
     ss << "  JIT Command: \"" << compiler.cmd_template << "\"\n";
+    if (useTier1("")) {
+        ss << "  JIT Tier-1 Command: \"" << tier1_compiler.cmd_template << "\"\n";
+    }
     return ss.str();
 }
 
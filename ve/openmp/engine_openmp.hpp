@@ -32,12 +32,14 @@ If not, see <http://www.gnu.org/licenses/>.
 #include <jitk/fuser_cache.hpp>
 #include <jitk/codegen_util.hpp>
 #include <jitk/codegen_cache.hpp>
+#include <jitk/worker_pool.hpp>
+#include <jitk/kernel_cache.hpp>
 
 #include <jitk/engines/engine_cpu.hpp>
 
 namespace bohrium {
 
-typedef void (*KernelFunction)(void* data_list[], uint64_t offset_strides[], bh_constant_value constants[]);
+typedef jitk::KernelFunction KernelFunction;
 typedef void (*UserKernelFunction)(void* data_list[]);
 
 class EngineOpenMP : public jitk::EngineCPU {
@@ -48,6 +50,61 @@ private:
     // The compiler to use when function doesn't exist
     const jitk::Compiler compiler;
 
+    // The persistent cache of compiled kernels, which is shared with other processes
+    const jitk::KernelCache kernel_cache;
+
+    // The workers that compile the kernels of a flush in parallel and the compilations in progress,
+    // which produce the path of the binary file
+    jitk::WorkerPool compile_pool;
+    std::map<uint64_t, std::shared_future<boost::filesystem::path> > _pending_compiles;
+
+    // Tiered compilation: kernels are first compiled by the fast `tier1_compiler` and recompiled by `compiler`
+    // in the background when they become hot (see `updateFunction()`)
+    const bool tiered;
+    const jitk::Compiler tier1_compiler;
+    uint64_t tier1_compilation_hash;
+    // The number of calls or the total execution time (in seconds) that makes a kernel hot
+    const uint64_t tiered_calls;
+    const double tiered_time;
+
+    // A kernel that runs its tier-1 build
+    struct TieredKernel {
+        std::string source;
+        std::string func_name;
+        // The background compilation by `compiler`, which is invalid until the kernel becomes hot
+        std::shared_future<boost::filesystem::path> compilation;
+    };
+    std::map<uint64_t, TieredKernel> _tier1_kernels;
+
+    // Return true when the kernel is compiled by `tier1_compiler` first
+    bool useTier1(const std::string &compile_cmd) const {
+        return tiered and compile_cmd.empty();
+    }
+
+    // Return the path of a new binary of the kernel `hash` in the tmp dir
+    boost::filesystem::path tmpBinfile(uint64_t hash, bool tier1) const;
+
+    // Compile `source` into the shared library `binfile` using `tier1_compiler` when `tier1` is true
+    void compileFunction(const boost::filesystem::path &binfile, const std::string &source, uint64_t hash,
+                         const std::string &compile_cmd, bool tier1) const;
+
+    // Compile `source` and return the path of the binary file. Unless `tier1` is true, the binary file is
+    // published to the kernel cache and we use the kernel of another process that compiled it first.
+    // NB: this is thread-safe thus the compile workers call it
+    boost::filesystem::path buildFunction(const std::string &source, uint64_t hash,
+                                          const std::string &compile_cmd, bool tier1) const;
+
+    // Load the function `func_name` from the shared library `binfile`
+    void *loadLibrary(const boost::filesystem::path &binfile, const std::string &func_name);
+
+    // The NUMA nodes of the machine and the list of their CPUs (e.g. "0-15,32-47")
+    std::map<int, std::string> numa_nodes;
+    // The placement of arrays on the NUMA nodes, which is "none" on machines with a single NUMA node
+    std::string numa_placement{"none"};
+
+    // Detect the NUMA nodes and setup the thread binding and the placement of arrays on the nodes
+    void initNUMA();
+
 public:
     // Return a kernel function based on the given 'source' and the name of the kernel function
     KernelFunction getFunction(const std::string &source, const std::string &func_name,
@@ -57,10 +114,17 @@ public:
 
     ~EngineOpenMP() override;
 
-    void execute(const jitk::SymbolTable &symbols,
-                 const std::string &source,
-                 uint64_t codegen_hash,
-                 const std::vector<const bh_instruction*> &constants) override;
+    KernelFunction execute(const jitk::SymbolTable &symbols,
+                           const std::string &source,
+                           uint64_t codegen_hash,
+                           const std::vector<const bh_instruction*> &constants) override;
+
+    // Compile all kernels in `source_list` that are not compiled already using the compile workers
+    void prepareFunctions(const std::vector<std::pair<std::string, uint64_t> > &source_list) override;
+
+    // Trigger the background recompilation of hot tier-1 kernels and swap in the result when it is ready
+    KernelFunction updateFunction(uint64_t source_hash, const jitk::KernelStats &kernel_stats,
+                                  KernelFunction func) override;
 
     void writeKernel(const jitk::LoopB &kernel,
                      const jitk::SymbolTable &symbols,
@@ -80,6 +144,25 @@ public:
                         const std::vector<uint64_t> &thread_stack,
                         std::stringstream &out) override;
 
+    // Write long accumulations as a blocked parallel scan and reductions over the outer axis blocked along the output
+    bool loopWriter(const jitk::SymbolTable &symbols,
+                    jitk::Scope &scope,
+                    const jitk::LoopB &block,
+                    const std::vector<uint64_t> &thread_stack,
+                    std::stringstream &out) override;
+
+    // Open a parallel region with per-thread partial results of the reductions into arrays (if any)
+    void loopPrologueWriter(const jitk::SymbolTable &symbols,
+                            jitk::Scope &scope,
+                            const jitk::LoopB &block,
+                            std::stringstream &out) override;
+
+    // Combine the per-thread partial results and close the parallel region opened by `loopPrologueWriter()`
+    void loopEpilogueWriter(const jitk::SymbolTable &symbols,
+                            jitk::Scope &scope,
+                            const jitk::LoopB &block,
+                            std::stringstream &out) override;
+
     // Return a YAML string describing this component
     std::string info() const override;
 
@@ -95,6 +178,22 @@ public:
                            const std::string &compile_cmd, const std::string &tag, const std::string &param);
 
 private:
+    // Writes the accumulations of `block` as a blocked parallel scan (see `openmp_scan_compatible()`)
+    void writeScanLoop(const jitk::SymbolTable &symbols,
+                       jitk::Scope &scope,
+                       const jitk::LoopB &block,
+                       const std::vector<uint64_t> &thread_stack,
+                       std::stringstream &out);
+
+    // Writes the reductions over the axis of `block` as row-wise accumulations where the threads split the output
+    // axis into blocks of `block_size` elements (see `openmp_column_reduction_compatible()`)
+    void writeColumnReductionLoop(const jitk::SymbolTable &symbols,
+                                  jitk::Scope &scope,
+                                  const jitk::LoopB &block,
+                                  int64_t block_size,
+                                  const std::vector<uint64_t> &thread_stack,
+                                  std::stringstream &out);
+
     // Writes the union of C99 types that can make up a constant
     inline void writeUnionType(std::stringstream& out) {
         out << "\ntypedef struct { uint64_t x, y; } r123_t" << ";\n";
@@ -92,3 +92,105 @@ bool openmp_atomic_compatible(bh_opcode opcode) {
             return false;
     }
 }
+
+// Can the reduction 'instr' of 'block' reduce into per-thread partial results? The partial results shadow the
+// whole output base array thus the output view must cover the base array, which no other instruction may access
+bool openmp_partial_compatible(const bohrium::jitk::InstrPtr &instr, const bohrium::jitk::LoopB &block) {
+    const bh_view &out = instr->operand[0];
+    const bh_view &in = instr->operand[1];
+    if (not bh_opcode_is_reduction(instr->opcode)) {
+        return false;
+    }
+    if (in.shape[instr->sweep_axis()] == 0 or out.base->nelem() != in.shape.prod() / in.shape[instr->sweep_axis()]) {
+        return false;
+    }
+    for (const bohrium::jitk::InstrPtr &other: bohrium::jitk::iterator::allInstr(block)) {
+        for (size_t i = 0; i < other->operand.size(); ++i) {
+            const bh_view &view = other->operand[i];
+            if (not view.isConstant() and view.base == out.base and not(other == instr and i == 0)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Is the 'block' compatible with a parallel scan? All sweeps must be additions or multiplications that accumulates
+// along the axis of the innermost 'block'. Additionally, a chunk of iterations must be recomputable: an instruction
+// may only read arrays written by previous instructions of the iteration and all access of a written array must go
+// through the same view. Temporary arrays are local to the iteration thus they may be updated in-place.
+bool openmp_scan_compatible(const bohrium::jitk::LoopB &block, const bohrium::jitk::Scope &scope) {
+    if (block.rank != 0 or not block.isInnermost() or block._sweeps.empty()) {
+        return false;
+    }
+    for (const bohrium::jitk::InstrPtr &instr: block._sweeps) {
+        if (not(instr->opcode == BH_ADD_ACCUMULATE or instr->opcode == BH_MULTIPLY_ACCUMULATE) or
+            instr->sweep_axis() != block.rank or not scope.isArray(instr->operand[0])) {
+            return false;
+        }
+    }
+    std::vector<bohrium::jitk::InstrPtr> instr_list;
+    for (const bohrium::jitk::InstrPtr &instr: bohrium::jitk::iterator::allInstr(block)) {
+        instr_list.push_back(instr);
+    }
+    const std::set<bh_base *> local_tmps = block.getLocalTemps();
+    for (size_t i = 0; i < instr_list.size(); ++i) {
+        const bohrium::jitk::InstrPtr &instr = instr_list[i];
+        if (instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+            return false;
+        }
+        for (size_t o = 0; o < instr->operand.size(); ++o) {
+            const bh_view &view = instr->operand[o];
+            if (view.isConstant() or scope.isTmp(view.base) or
+                (local_tmps.find(view.base) != local_tmps.end() and not scope.symbols.isAlwaysArray(view.base))) {
+                continue;
+            }
+            for (size_t j = 0; j < instr_list.size(); ++j) {
+                const bh_view &written = instr_list[j]->operand[0];
+                if (written.base == view.base and (not(written == view) or (o > 0 and j >= i))) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Is the 'block' compatible with column-wise reductions blocked along the output axis? All sweeps must be reductions
+// into arrays along the axis of 'block', which must consist of innermost loops over an output axis longer than
+// 'block_size'. Since the blocking reorders the iterations, all access of an array written in 'block' must go through
+// the same view.
+bool openmp_column_reduction_compatible(const bohrium::jitk::LoopB &block, const bohrium::jitk::Scope &scope,
+                                        int64_t block_size) {
+    if (block.rank != 0 or block._sweeps.empty() or block._block_list.empty()) {
+        return false;
+    }
+    for (const bohrium::jitk::InstrPtr &instr: block._sweeps) {
+        if (not bh_opcode_is_reduction(instr->opcode) or instr->sweep_axis() != block.rank or
+            not scope.isArray(instr->operand[0])) {
+            return false;
+        }
+    }
+    for (const bohrium::jitk::Block &b: block._block_list) {
+        if (b.isInstr() or not b.getLoop().isInnermost() or not b.getLoop()._sweeps.empty() or
+            b.getLoop().size != block._block_list.front().getLoop().size) {
+            return false;
+        }
+    }
+    if (block._block_list.front().getLoop().size <= block_size) {
+        return false;
+    }
+    for (const bohrium::jitk::InstrPtr &instr: bohrium::jitk::iterator::allInstr(block)) {
+        if (instr->opcode == BH_GATHER or instr->opcode == BH_SCATTER or instr->opcode == BH_COND_SCATTER) {
+            return false;
+        }
+        for (const bh_view &view: instr->getViews()) {
+            for (const bohrium::jitk::InstrPtr &other: bohrium::jitk::iterator::allInstr(block)) {
+                if (other->operand[0].base == view.base and not(other->operand[0] == view)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}